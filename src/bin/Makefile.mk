@@ -1,5 +1,6 @@
 
-bin_PROGRAMS = src/bin/etch_test
+bin_PROGRAMS = src/bin/etch_test src/bin/etch_bench src/bin/etch_replay \
+src/bin/etch_keyframes_test
 
 src_bin_etch_test_SOURCES = \
 src/bin/etch_test.c
@@ -8,6 +9,60 @@ src_bin_etch_test_CPPFLAGS = \
 -I$(top_srcdir)/src/lib \
 @ETCH_CFLAGS@
 
+if ETCH_HAVE_TIMERFD
+src_bin_etch_test_CPPFLAGS += -DHAVE_ETCH_CLOCK
+endif
+
 src_bin_etch_test_LDADD = \
 $(top_builddir)/src/lib/libetch.la \
 @ETCH_LIBS@
+
+src_bin_etch_bench_SOURCES = \
+src/bin/etch_bench.c
+
+src_bin_etch_bench_CPPFLAGS = \
+-I$(top_srcdir)/src/lib \
+@ETCH_CFLAGS@
+
+src_bin_etch_bench_LDADD = \
+$(top_builddir)/src/lib/libetch.la \
+@ETCH_LIBS@ \
+-lm
+
+src_bin_etch_replay_SOURCES = \
+src/bin/etch_replay.c
+
+src_bin_etch_replay_CPPFLAGS = \
+-I$(top_srcdir)/src/lib \
+@ETCH_CFLAGS@
+
+src_bin_etch_replay_LDADD = \
+$(top_builddir)/src/lib/libetch.la \
+@ETCH_LIBS@
+
+src_bin_etch_keyframes_test_SOURCES = \
+src/bin/etch_keyframes_test.c
+
+src_bin_etch_keyframes_test_CPPFLAGS = \
+-I$(top_srcdir)/src/lib \
+@ETCH_CFLAGS@
+
+src_bin_etch_keyframes_test_LDADD = \
+$(top_builddir)/src/lib/libetch.la \
+@ETCH_LIBS@ \
+-lm
+
+if ETCH_HAVE_SHM
+bin_PROGRAMS += src/bin/etch_export_test
+
+src_bin_etch_export_test_SOURCES = \
+src/bin/etch_export_test.c
+
+src_bin_etch_export_test_CPPFLAGS = \
+-I$(top_srcdir)/src/lib \
+@ETCH_CFLAGS@
+
+src_bin_etch_export_test_LDADD = \
+$(top_builddir)/src/lib/libetch.la \
+@ETCH_LIBS@
+endif
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define HAVE_RDTSC 1
+#endif
+
+#include "Etch.h"
+
+/* Microbenchmark of the interpolator types, for every type and precision
+ * prints the time and cycles it takes to evaluate one sample and the
+ * maximum error against the exact version. The samples are evaluated with
+ * etch_animation_sample_range() so only the keyframe kernels are timed, not
+ * the ticks */
+
+#define ROUNDS 100
+#define SAMPLES 10000
+#define ERROR_SAMPLES 10000
+
+static const char *_names[ETCH_INTERPOLATOR_TYPES] = {
+	[ETCH_INTERPOLATOR_DISCRETE] = "discrete",
+	[ETCH_INTERPOLATOR_LINEAR] = "linear",
+	[ETCH_INTERPOLATOR_COSIN] = "cosin",
+	[ETCH_INTERPOLATOR_QUADRATIC] = "quadratic",
+	[ETCH_INTERPOLATOR_CUBIC] = "cubic",
+	[ETCH_INTERPOLATOR_EXPO] = "expo",
+	[ETCH_INTERPOLATOR_BACK] = "back",
+	[ETCH_INTERPOLATOR_ELASTIC] = "elastic",
+	[ETCH_INTERPOLATOR_BOUNCE] = "bounce",
+	[ETCH_INTERPOLATOR_STEPS] = "steps",
+	[ETCH_INTERPOLATOR_SMOOTHSTEP] = "smoothstep",
+	[ETCH_INTERPOLATOR_SPRING] = "spring",
+};
+
+static void _double_cb(Etch_Animation_Keyframe *k, const Etch_Data *curr, const Etch_Data *prev, void *data)
+{
+}
+
+static uint64_t _cycles(void)
+{
+#ifdef HAVE_RDTSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static Etch_Animation * animation_setup(Etch *e, Etch_Interpolator_Type type)
+{
+	Etch_Animation *ea;
+	Etch_Animation_Keyframe *ek;
+	Etch_Data data;
+
+	ea = etch_animation_add(e, ETCH_DOUBLE, _double_cb, NULL, NULL, NULL, NULL);
+	/* first keyframe */
+	ek = etch_animation_keyframe_add(ea);
+	etch_animation_keyframe_type_set(ek, type);
+	etch_animation_keyframe_quadratic_value_set(ek, 0.25, 0.75);
+	if (type == ETCH_INTERPOLATOR_STEPS)
+		etch_animation_keyframe_steps_value_set(ek, 10);
+	data.data.d = 0;
+	etch_animation_keyframe_value_set(ek, &data);
+	etch_animation_keyframe_time_set(ek, 0);
+	/* second keyframe */
+	ek = etch_animation_keyframe_add(ea);
+	data.data.d = 1;
+	etch_animation_keyframe_value_set(ek, &data);
+	etch_animation_keyframe_time_set(ek, ETCH_SECOND);
+	/* a spring that settles in about a second */
+	if (type == ETCH_INTERPOLATOR_SPRING)
+		etch_animation_keyframe_spring_value_set(etch_animation_keyframe_get(ea, 0), 100, 10, 0);
+	etch_animation_enable(ea);
+
+	return ea;
+}
+
+static void bench(Etch_Interpolator_Type type, Etch_Precision precision)
+{
+	Etch *e;
+	Etch_Animation *a;
+	static double out[SAMPLES];
+	double start;
+	double ns;
+	uint64_t cstart;
+	uint64_t cycles;
+	int i;
+
+	e = etch_new();
+	etch_precision_set(e, precision);
+	a = animation_setup(e, type);
+	/* warm up */
+	etch_animation_sample_range(a, 0, ETCH_SECOND / SAMPLES, SAMPLES, out);
+
+	start = _now();
+	cstart = _cycles();
+	for (i = 0; i < ROUNDS; i++)
+		etch_animation_sample_range(a, 0, ETCH_SECOND / SAMPLES, SAMPLES, out);
+	cycles = _cycles() - cstart;
+	ns = _now() - start;
+
+	printf("%-12s %-6s %10.2f %12.2f", _names[type],
+			precision == ETCH_PRECISION_FAST ? "fast" : "exact",
+			ns / (ROUNDS * SAMPLES),
+			(double)cycles / (ROUNDS * SAMPLES));
+	etch_delete(e);
+}
+
+static double error(Etch_Interpolator_Type type)
+{
+	Etch *exact, *fast;
+	Etch_Animation *ea, *fa;
+	double max = 0;
+	int i;
+
+	exact = etch_new();
+	fast = etch_new();
+	etch_precision_set(fast, ETCH_PRECISION_FAST);
+	ea = animation_setup(exact, type);
+	fa = animation_setup(fast, type);
+	for (i = 0; i <= ERROR_SAMPLES; i++)
+	{
+		Etch_Data ev, fv;
+
+		etch_timer_set(exact, (ETCH_SECOND * i) / ERROR_SAMPLES);
+		etch_timer_set(fast, (ETCH_SECOND * i) / ERROR_SAMPLES);
+		etch_animation_data_get(ea, &ev);
+		etch_animation_data_get(fa, &fv);
+		if (fabs(ev.data.d - fv.data.d) > max)
+			max = fabs(ev.data.d - fv.data.d);
+	}
+	etch_delete(exact);
+	etch_delete(fast);
+
+	return max;
+}
+
+int main(void)
+{
+	Etch_Interpolator_Type type;
+
+	etch_init();
+	printf("%-12s %-6s %10s %12s %12s\n", "curve", "mode", "ns/sample",
+			"cycles/sample", "max error");
+	for (type = 0; type < ETCH_INTERPOLATOR_TYPES; type++)
+	{
+		bench(type, ETCH_PRECISION_EXACT);
+		printf("\n");
+		bench(type, ETCH_PRECISION_FAST);
+		printf(" %12g\n", error(type));
+	}
+	etch_shutdown();
+
+	return 0;
+}
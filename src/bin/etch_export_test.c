@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "Etch.h"
+
+/* Checks the exporter against a reader on another process. The parent ticks
+ * animations whose values are a function of the frame, the child reads the
+ * slots as fast as possible and checks every value against the frame it was
+ * published with, and that the frames never go back */
+
+#define FPS 100
+#define FRAMES 1000
+#define SLOTS 4
+#define MAX_READS 100000000
+
+static void _cb(Etch_Animation_Keyframe *k, const Etch_Data *curr, const Etch_Data *prev, void *data)
+{
+}
+
+/* an animation that goes linearly from 0 to scale * FRAMES on FRAMES */
+static Etch_Animation * animation_setup(Etch *e, Etch_Data_Type dtype, int scale)
+{
+	Etch_Animation *a;
+	Etch_Animation_Keyframe *k;
+	Etch_Data data;
+
+	a = etch_animation_add(e, dtype, _cb, NULL, NULL, NULL, NULL);
+	data.type = dtype;
+	k = etch_animation_keyframe_add(a);
+	etch_animation_keyframe_type_set(k, ETCH_INTERPOLATOR_LINEAR);
+	if (dtype == ETCH_DOUBLE)
+		data.data.d = 0;
+	else
+		data.data.i32 = 0;
+	etch_animation_keyframe_value_set(k, &data);
+	etch_animation_keyframe_time_set(k, 0);
+	k = etch_animation_keyframe_add(a);
+	if (dtype == ETCH_DOUBLE)
+		data.data.d = scale * FRAMES;
+	else
+		data.data.i32 = scale * FRAMES;
+	etch_animation_keyframe_value_set(k, &data);
+	etch_animation_keyframe_time_set(k, (Etch_Time)FRAMES * ETCH_SECOND / FPS);
+	etch_animation_enable(a);
+
+	return a;
+}
+
+static int reader(const char *name)
+{
+	Etch_Export_Reader *r;
+	unsigned long last = 0;
+	unsigned long reads = 0;
+	unsigned long bad = 0;
+	unsigned long i;
+
+	r = etch_export_reader_new(name);
+	if (!r)
+	{
+		printf("Can not open the export %s\n", name);
+		return 1;
+	}
+	for (i = 0; i < MAX_READS && last < FRAMES; i++)
+	{
+		Etch_Data v[SLOTS];
+		unsigned long frame;
+
+		if (!etch_export_reader_read(r, 0, SLOTS, v, &frame))
+		{
+			bad++;
+			break;
+		}
+		reads++;
+		if (frame < last)
+			bad++;
+		last = frame;
+		/* the animations are published from the first tick */
+		if (!frame)
+			continue;
+		if (v[0].type != ETCH_DOUBLE || v[0].data.d < frame - 1e-6 ||
+				v[0].data.d > frame + 1e-6)
+			bad++;
+		if (v[1].type != ETCH_INT32 || v[1].data.i32 != 2 * (int)frame)
+			bad++;
+		if (v[2].type != ETCH_DATATYPES || v[3].type != ETCH_DATATYPES)
+			bad++;
+	}
+	etch_export_reader_delete(r);
+	printf("%-12s %lu\n", "reads", reads);
+	printf("%-12s %lu\n", "last frame", last);
+	printf("%-12s %lu\n", "errors", bad);
+
+	return bad || last < FRAMES;
+}
+
+/* empty a slot and delete the animation of another one, both slots must be
+ * read as empty */
+static int slots_clear(Etch_Export *ex, const char *name, Etch_Animation *a)
+{
+	Etch_Export_Reader *r;
+	Etch_Data v[SLOTS];
+	int bad;
+
+	r = etch_export_reader_new(name);
+	if (!r)
+		return 1;
+	etch_export_animation_set(ex, 1, NULL);
+	etch_animation_delete(a);
+	bad = !etch_export_reader_read(r, 0, SLOTS, v, NULL) ||
+			v[0].type != ETCH_DATATYPES || v[1].type != ETCH_DATATYPES;
+	etch_export_reader_delete(r);
+	printf("%-12s %s\n", "clear", bad ? "FAILED" : "OK");
+
+	return bad;
+}
+
+int main(void)
+{
+	Etch *e;
+	Etch_Export *ex;
+	Etch_Animation *a;
+	char name[64];
+	pid_t pid;
+	int status;
+	int bad;
+	int i;
+
+	etch_init();
+	e = etch_new();
+	etch_timer_fps_set(e, FPS);
+	snprintf(name, sizeof(name), "/etch_export_test_%d", (int)getpid());
+	ex = etch_export_new(e, name, SLOTS);
+	if (!ex)
+	{
+		printf("Can not create the export %s\n", name);
+		etch_shutdown();
+		return 1;
+	}
+	a = animation_setup(e, ETCH_DOUBLE, 1);
+	etch_export_animation_set(ex, 0, a);
+	etch_export_animation_set(ex, 1, animation_setup(e, ETCH_INT32, 2));
+
+	pid = fork();
+	if (pid < 0)
+	{
+		printf("Can not fork the reader\n");
+		etch_export_delete(ex);
+		etch_delete(e);
+		etch_shutdown();
+		return 1;
+	}
+	if (!pid)
+	{
+		status = reader(name);
+		fflush(stdout);
+		_exit(status);
+	}
+	/* leave some time to the reader between the ticks */
+	for (i = 0; i < FRAMES; i++)
+	{
+		etch_timer_tick(e);
+		if (!(i % 10))
+			usleep(100);
+	}
+	waitpid(pid, &status, 0);
+	bad = slots_clear(ex, name, a);
+	etch_export_delete(ex);
+	etch_delete(e);
+	etch_shutdown();
+
+	if (bad || !WIFEXITED(status) || WEXITSTATUS(status))
+	{
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "Etch.h"
+
+/* Checks the operations that rewrite the keyframes of an animation, every
+ * check prints its result and the program fails if any of them does */
+
+static int _failed = 0;
+
+static void _cb(Etch_Animation_Keyframe *k, const Etch_Data *curr, const Etch_Data *prev, void *data)
+{
+}
+
+static void check(const char *name, Eina_Bool ok)
+{
+	printf("%-40s %s\n", name, ok ? "OK" : "FAILED");
+	if (!ok)
+		_failed++;
+}
+
+static Etch_Animation_Keyframe * keyframe_add(Etch_Animation *a,
+		Etch_Interpolator_Type type, Etch_Time t, double value)
+{
+	Etch_Animation_Keyframe *k;
+	Etch_Data data;
+
+	k = etch_animation_keyframe_add(a);
+	etch_animation_keyframe_type_set(k, type);
+	data.type = ETCH_DOUBLE;
+	data.data.d = value;
+	etch_animation_keyframe_value_set(k, &data);
+	etch_animation_keyframe_time_set(k, t);
+
+	return k;
+}
+
+/* remove a keyframe of a line and simplify it, the line must stay */
+static void simplify_after_remove(void)
+{
+	Etch *e;
+	Etch_Animation *a;
+	Etch_Animation_Keyframe *k = NULL;
+	double out[20];
+	unsigned int removed;
+	int i;
+	Eina_Bool ok = EINA_TRUE;
+
+	e = etch_new();
+	a = etch_animation_add(e, ETCH_DOUBLE, _cb, NULL, NULL, NULL, NULL);
+	for (i = 0; i < 20; i++)
+	{
+		Etch_Animation_Keyframe *tmp;
+
+		tmp = keyframe_add(a, ETCH_INTERPOLATOR_LINEAR, i * ETCH_SECOND, i);
+		if (i == 5)
+			k = tmp;
+	}
+	etch_animation_enable(a);
+	etch_animation_keyframe_remove(a, k);
+	removed = etch_animation_simplify(a, 1e-6);
+	check("simplify after remove", removed == 17);
+	etch_animation_sample_range(a, 0, ETCH_SECOND, 20, out);
+	for (i = 0; i < 20; i++)
+	{
+		if (fabs(out[i] - i) > 1e-6)
+			ok = EINA_FALSE;
+	}
+	check("simplified values", ok);
+	etch_delete(e);
+}
+
+/* the last sample of an animation is at its end, not at its start */
+static void sample_end(void)
+{
+	Etch *e;
+	Etch_Animation *a;
+	Etch_Animation_Keyframe *k;
+	Etch_Data data;
+	uint32_t out[11];
+	int i;
+	Eina_Bool ok = EINA_TRUE;
+
+	e = etch_new();
+	a = etch_animation_add(e, ETCH_UINT32, _cb, NULL, NULL, NULL, NULL);
+	data.type = ETCH_UINT32;
+	k = etch_animation_keyframe_add(a);
+	etch_animation_keyframe_type_set(k, ETCH_INTERPOLATOR_LINEAR);
+	data.data.u32 = 100;
+	etch_animation_keyframe_value_set(k, &data);
+	etch_animation_keyframe_time_set(k, 0);
+	k = etch_animation_keyframe_add(a);
+	data.data.u32 = 0;
+	etch_animation_keyframe_value_set(k, &data);
+	etch_animation_keyframe_time_set(k, ETCH_SECOND);
+	etch_animation_enable(a);
+	etch_animation_sample_range(a, 0, ETCH_SECOND / 10, 11, out);
+	/* the integers are rounded up */
+	for (i = 0; i < 11; i++)
+	{
+		if (abs((int)out[i] - (100 - 10 * i)) > 1)
+			ok = EINA_FALSE;
+	}
+	check("sample at the end", ok && out[0] == 100 && out[10] == 0);
+	etch_delete(e);
+}
+
+/* an animation with irregular times over several blocks of a track */
+#define COMPACT_KEYFRAMES 40
+
+static Etch_Animation * compact_setup(Etch *e, Etch_Time *times)
+{
+	Etch_Animation *a;
+	int i;
+
+	a = etch_animation_add(e, ETCH_DOUBLE, _cb, NULL, NULL, NULL, NULL);
+	for (i = 0; i < COMPACT_KEYFRAMES; i++)
+	{
+		keyframe_add(a, ETCH_INTERPOLATOR_LINEAR, times[i],
+				500 + 500 * sin(i * 0.7));
+	}
+	etch_animation_enable(a);
+	return a;
+}
+
+/* compact an animation and compare it with the original on every keyframe,
+ * the ones where a block starts included, and between them */
+static void compact_decode(unsigned int bits, const char *name)
+{
+	Etch *e;
+	Etch_Animation *a;
+	Etch_Animation *c;
+	Etch_Time keys[COMPACT_KEYFRAMES];
+	Etch_Time times[2 * (COMPACT_KEYFRAMES - 1)];
+	double expected[2 * (COMPACT_KEYFRAMES - 1)];
+	double out[2 * (COMPACT_KEYFRAMES - 1)];
+	double step;
+	unsigned int n = 2 * (COMPACT_KEYFRAMES - 1);
+	unsigned int i;
+	Eina_Bool ok;
+
+	keys[0] = 0;
+	for (i = 1; i < COMPACT_KEYFRAMES; i++)
+		keys[i] = keys[i - 1] + (100 + (i % 3) * 7) * ETCH_SECOND / 1000;
+	for (i = 0; i < COMPACT_KEYFRAMES - 1; i++)
+	{
+		times[2 * i] = keys[i];
+		times[2 * i + 1] = (keys[i] + keys[i + 1]) / 2;
+	}
+	/* the range of the values is 1000 */
+	step = 1000.0 / ((1 << bits) - 1);
+
+	e = etch_new();
+	a = compact_setup(e, keys);
+	c = compact_setup(e, keys);
+	ok = etch_animation_compact(c, bits);
+	etch_animation_sample(a, times, n, expected);
+	if (etch_animation_sample(c, times, n, out) != n)
+		ok = EINA_FALSE;
+	for (i = 0; i < n; i++)
+	{
+		if (fabs(out[i] - expected[i]) > step)
+			ok = EINA_FALSE;
+	}
+	check(name, ok);
+	etch_delete(e);
+}
+
+int main(void)
+{
+	etch_init();
+	simplify_after_remove();
+	sample_end();
+	compact_decode(8, "compact 8 bits");
+	compact_decode(16, "compact 16 bits");
+	etch_shutdown();
+
+	return _failed ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Etch.h"
+
+/* Replays a log written with etch_record_start(), as fast as possible or at
+ * the pace it was recorded, and prints the throughput of the whole replay
+ * and the latency of every call that moved the timer */
+
+static Etch_Time _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Etch_Time)ts.tv_sec * ETCH_SECOND + ts.tv_nsec;
+}
+
+static void _sleep_until(Etch_Time t)
+{
+	struct timespec ts;
+
+	ts.tv_sec = t / ETCH_SECOND;
+	ts.tv_nsec = t % ETCH_SECOND;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+static int _cmp(const void *a, const void *b)
+{
+	Etch_Time ta = *(const Etch_Time *)a;
+	Etch_Time tb = *(const Etch_Time *)b;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [--paced] file\n", name);
+	printf("--paced Wait between the calls as long as when recorded\n");
+}
+
+int main(int argc, char **argv)
+{
+	Etch_Replay *r;
+	Etch_Time *latencies = NULL;
+	Etch_Time start, end, total = 0;
+	Etch_Time t;
+	const char *file = NULL;
+	unsigned int size = 0;
+	unsigned int ticks = 0;
+	unsigned long calls = 0;
+	Eina_Bool paced = EINA_FALSE;
+	Eina_Bool timer;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--paced"))
+			paced = EINA_TRUE;
+		else
+			file = argv[i];
+	}
+	if (!file)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	etch_init();
+	r = etch_replay_new(file);
+	if (!r)
+	{
+		printf("Can not load the log %s\n", file);
+		etch_shutdown();
+		return 1;
+	}
+
+	start = _now();
+	for (;;)
+	{
+		Etch_Time before;
+		Eina_Bool ret;
+
+		/* wait before the call, as the application did */
+		if (paced && etch_replay_next_time_get(r, &t))
+			_sleep_until(start + t);
+		before = _now();
+		ret = etch_replay_step(r, &t, &timer);
+		if (!ret)
+			break;
+		calls++;
+		if (!timer)
+			continue;
+		/* the calls that move the timer are the ones that evaluate */
+		if (ticks == size)
+		{
+			size = size ? size * 2 : 1024;
+			latencies = realloc(latencies, sizeof(Etch_Time) * size);
+		}
+		latencies[ticks] = _now() - before;
+		total += latencies[ticks];
+		ticks++;
+	}
+	end = _now();
+	etch_replay_delete(r);
+	etch_shutdown();
+
+	printf("%-12s %lu\n", "calls", calls);
+	printf("%-12s %u\n", "ticks", ticks);
+	printf("%-12s %.3f ms\n", "total", (end - start) / 1e6);
+	if (ticks)
+	{
+		qsort(latencies, ticks, sizeof(Etch_Time), _cmp);
+		printf("%-12s %.1f\n", "ticks/s", ticks * 1e9 / (end - start));
+		printf("%-12s %.3f us\n", "avg", total / 1e3 / ticks);
+		printf("%-12s %.3f us\n", "p50", latencies[ticks / 2] / 1e3);
+		printf("%-12s %.3f us\n", "p99", latencies[(ticks * 99) / 100] / 1e3);
+		printf("%-12s %.3f us\n", "max", latencies[ticks - 1] / 1e3);
+	}
+	free(latencies);
+
+	return 0;
+}
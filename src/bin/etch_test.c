@@ -5,6 +5,8 @@
 
 #ifdef _WIN32
 # include <windows.h>
+#elif defined(HAVE_ETCH_CLOCK)
+# include <poll.h>
 #endif
 
 #include "Etch.h"
@@ -13,6 +15,8 @@
 
 #ifdef _WIN32
 HANDLE timer = NULL;
+#elif defined(HAVE_ETCH_CLOCK)
+Etch_Clock *_clock = NULL;
 #else
 int _timer_event = 0;
 #endif
@@ -42,6 +46,12 @@ static void timer_setup(void)
 	timer = CreateWaitableTimer(NULL, TRUE, "WaitableTimer");
 	SetWaitableTimer(timer, &time, 0, NULL, NULL, 0);
 }
+#elif defined(HAVE_ETCH_CLOCK)
+static void timer_setup(Etch *e)
+{
+	_clock = etch_clock_new(e);
+	etch_clock_start(_clock);
+}
 #else
 /* Timer function */
 static void timer_signal_cb(int s)
@@ -178,7 +188,11 @@ int main(void)
 	animation_uint32_setup(e);
 	//animation_argb_setup(e);
 	//animation_string_setup(e);
+#if !defined(_WIN32) && defined(HAVE_ETCH_CLOCK)
+	timer_setup(e);
+#else
 	timer_setup();
+#endif
 	/* to exit the main loop we should check that the etch animation has finished */
 	while (!(etch_timer_has_end(e)))
 	{
@@ -186,6 +200,14 @@ int main(void)
 		WaitForSingleObject(timer, INFINITE);
 		/* send a tick to etch :) and wait for events */
 		etch_timer_tick(e);
+#elif defined(HAVE_ETCH_CLOCK)
+		struct pollfd pfd;
+
+		pfd.fd = etch_clock_fd_get(_clock);
+		pfd.events = POLLIN;
+		/* the clock ticks the etch :) */
+		if (poll(&pfd, 1, -1) > 0)
+			etch_clock_dispatch(_clock);
 #else
 		if (_timer_event)
 		{
@@ -195,6 +217,9 @@ int main(void)
 		}
 #endif
 	}
+#if !defined(_WIN32) && defined(HAVE_ETCH_CLOCK)
+	etch_clock_delete(_clock);
+#endif
 	etch_delete(e);
 	etch_shutdown();
 
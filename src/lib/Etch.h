@@ -47,6 +47,10 @@
 # endif
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @mainpage Etch
  * @section intro Introduction
@@ -83,9 +87,49 @@ EAPI unsigned int etch_timer_fps_get(Etch *e);
 EAPI void etch_timer_tick(Etch *e);
 EAPI int etch_timer_has_end(Etch *e);
 EAPI void etch_timer_goto(Etch *e, unsigned long frame);
+EAPI void etch_flush(Etch *e);
 EAPI void etch_timer_get(Etch *e, Etch_Time *t);
 EAPI void etch_timer_set(Etch *e, Etch_Time t);
 
+/**
+ * Precision of the interpolators that use transcendental functions
+ */
+typedef enum _Etch_Precision
+{
+	ETCH_PRECISION_EXACT, /**< Use the math library */
+	ETCH_PRECISION_FAST, /**< Use polynomial approximations, the absolute error is below 4e-6, for the springs relative to the largest distance to the final value */
+	ETCH_PRECISIONS, /**< Number of precisions */
+} Etch_Precision;
+
+EAPI void etch_precision_set(Etch *e, Etch_Precision p);
+EAPI Etch_Precision etch_precision_get(Etch *e);
+
+/**
+ * Priority of an animation when the ticks have a time budget
+ */
+typedef enum _Etch_Priority
+{
+	ETCH_PRIORITY_HIGH, /**< Evaluated on every tick, the default */
+	ETCH_PRIORITY_NORMAL, /**< Decimated only when the lower ones are not enough */
+	ETCH_PRIORITY_LOW, /**< Decimated before the normal ones */
+	ETCH_PRIORITY_BACKGROUND, /**< Decimated first, like offscreen animations */
+	ETCH_PRIORITIES
+} Etch_Priority;
+
+/**
+ * Report of a tick with a time budget
+ */
+typedef struct _Etch_Tick_Report
+{
+	Etch_Time cost; /**< Time the tick took */
+	unsigned int evaluated; /**< Number of animations evaluated */
+	unsigned int deferred; /**< Number of animations left for a later tick */
+	unsigned int rates[ETCH_PRIORITIES]; /**< Every how many ticks every priority has been evaluated */
+	unsigned int priority_deferred[ETCH_PRIORITIES]; /**< Number of animations of every priority left for a later tick */
+} Etch_Tick_Report;
+
+EAPI void etch_timer_tick_budget(Etch *e, Etch_Time budget, Etch_Tick_Report *r);
+
 /**
  * Data types for a property
  * TODO add fixed point types too
@@ -97,7 +141,7 @@ typedef enum _Etch_Data_Type
 	ETCH_FLOAT, /**< Single precision float */
 	ETCH_DOUBLE, /**< Double precision float */
 	ETCH_ARGB, /**< Color (Alpha, Red, Green, Blue) of 32 bits */
-	ETCH_STRING, /**< String type */
+	ETCH_STRING, /**< String type, the values are interned by Etch */
 	ETCH_EXTERNAL, /**< External (user provided) type */
 	ETCH_DATATYPES, /**< Number of data types */
 } Etch_Data_Type;
@@ -135,14 +179,44 @@ typedef enum _Etch_Interpolator_Type
 	ETCH_INTERPOLATOR_COSIN, /***< Cosin interpolation */
 	ETCH_INTERPOLATOR_QUADRATIC, /**< Quadratic bezier interpolation */
 	ETCH_INTERPOLATOR_CUBIC, /**< Cubic bezier interpolation */
+	ETCH_INTERPOLATOR_EXPO, /**< Exponential ease in and out */
+	ETCH_INTERPOLATOR_BACK, /**< Ease out overshooting the final value */
+	ETCH_INTERPOLATOR_ELASTIC, /**< Ease out oscillating around the final value */
+	ETCH_INTERPOLATOR_BOUNCE, /**< Ease out bouncing on the final value */
+	ETCH_INTERPOLATOR_STEPS, /**< Discrete steps of the same length */
+	ETCH_INTERPOLATOR_SMOOTHSTEP, /**< Hermite smoothstep interpolation */
+	ETCH_INTERPOLATOR_SPRING, /**< Damped spring */
 	ETCH_INTERPOLATOR_TYPES
 } Etch_Interpolator_Type;
 
+/*
+ * The back, elastic and spring calcs overshoot, m goes out of [0,1]. The
+ * integer and color interpolators saturate the result to the range of the
+ * type, every color channel to [0,255]
+ */
 static inline void etch_interpolate_argb(uint32_t a, uint32_t b, double m, uint32_t *r)
 {
 	uint32_t range;
 	uint32_t ag, rb;
 
+	if (m < 0 || m > 1)
+	{
+		uint32_t c = 0;
+		int shift;
+
+		for (shift = 0; shift < 32; shift += 8)
+		{
+			double ca = (a >> shift) & 0xff;
+			double cb = (b >> shift) & 0xff;
+			double v = rint(ca + (cb - ca) * m);
+
+			if (v < 0) v = 0;
+			else if (v > 255) v = 255;
+			c |= (uint32_t)v << shift;
+		}
+		*r = c;
+		return;
+	}
 	/* b - a*m + a */
 	range = rint(256 * m);
 	/* FIXME this can be optimized with MMX  or even use the libargb */
@@ -167,7 +241,9 @@ static inline void etch_interpolate_int32(int32_t a, int32_t b, double m, int32_
 	double rr;
 
 	rr = ((1 - m) * a) + (m * b);
-	*r = ceil(rr);
+	if (rr <= INT32_MIN) *r = INT32_MIN;
+	else if (rr >= INT32_MAX) *r = INT32_MAX;
+	else *r = ceil(rr);
 }
 
 static inline void etch_interpolate_uint32(uint32_t a, uint32_t b, double m, uint32_t *r)
@@ -175,7 +251,9 @@ static inline void etch_interpolate_uint32(uint32_t a, uint32_t b, double m, uin
 	double rr;
 
 	rr = ((1 - m) * a) + (m * b);
-	*r = ceil(rr);
+	if (rr <= 0) *r = 0;
+	else if (rr >= UINT32_MAX) *r = UINT32_MAX;
+	else *r = ceil(rr);
 }
 
 typedef void (*Etch_Interpolator)(Etch_Data *a, Etch_Data *b, double m, Etch_Data *res, void *data);
@@ -205,6 +283,10 @@ typedef void (*Etch_Free)(void *data);
 
 /**
  * Callback function used when a property value changes
+ * For ETCH_STRING animations the callback is only called when the
+ * interned string changes, so comparing the pointers is enough.
+ * It is not called either while the animation is on a segment where the
+ * value can not change, like a discrete one or one between equal values.
  * @param k The current keyframe
  * @param curr The current value
  * @param prev The previous value
@@ -218,6 +300,17 @@ typedef void (*Etch_Animation_Callback)(Etch_Animation_Keyframe *k, const Etch_D
  */
 typedef void (*Etch_Animation_State_Callback)(Etch_Animation *a, void *data);
 
+/**
+ * Direction of the keyframes on every repeat of an animation
+ */
+typedef enum _Etch_Animation_Direction
+{
+	ETCH_ANIMATION_FORWARD, /**< From the first keyframe to the last one */
+	ETCH_ANIMATION_REVERSE, /**< From the last keyframe to the first one */
+	ETCH_ANIMATION_ALTERNATE, /**< Forward on even repeats, reverse on odd ones */
+	ETCH_ANIMATION_DIRECTIONS
+} Etch_Animation_Direction;
+
 EAPI Etch_Animation * etch_animation_add(Etch *e, Etch_Data_Type dtype,
 		Etch_Animation_Callback cb,
 		Etch_Animation_State_Callback start,
@@ -244,9 +337,31 @@ EAPI void etch_animation_offset_add(Etch_Animation *a, Etch_Time inc);
 EAPI Etch * etch_animation_etch_get(Etch_Animation *a);
 EAPI Eina_Iterator * etch_animation_iterator_get(Etch_Animation *a);
 EAPI void etch_animation_data_get(Etch_Animation *a, Etch_Data *v);
+EAPI void etch_animation_data_get_array(Etch_Animation **a, unsigned int count,
+		Etch_Data *v);
+EAPI unsigned int etch_animation_id_get(Etch_Animation *a);
 EAPI void etch_animation_repeat_set(Etch_Animation *a, int times);
+EAPI void etch_animation_direction_set(Etch_Animation *a, Etch_Animation_Direction d);
+EAPI Etch_Animation_Direction etch_animation_direction_get(Etch_Animation *a);
+EAPI void etch_animation_priority_set(Etch_Animation *a, Etch_Priority p);
+EAPI Etch_Priority etch_animation_priority_get(Etch_Animation *a);
+EAPI void etch_animation_lazy_set(Etch_Animation *a, Eina_Bool lazy);
+EAPI Eina_Bool etch_animation_lazy_get(Etch_Animation *a);
 EAPI int etch_animation_keyframe_count(Etch_Animation *a);
 EAPI Etch_Animation_Keyframe * etch_animation_keyframe_get(Etch_Animation *a, unsigned int index);
+EAPI unsigned int etch_animation_simplify(Etch_Animation *a, double tolerance);
+EAPI Eina_Bool etch_animation_compact(Etch_Animation *a, unsigned int bits);
+EAPI Eina_Bool etch_animation_bind(Etch_Animation *a, void *dst,
+		uint32_t *dirty, unsigned int bit);
+EAPI unsigned int etch_animation_bind_array(Etch_Animation **a, unsigned int count,
+		void *dst, size_t stride, uint32_t *dirty);
+EAPI unsigned int etch_animation_keyframes_size_get(Etch_Animation *a);
+EAPI unsigned int etch_animation_sample(Etch_Animation *a, const Etch_Time *times,
+		unsigned int n, void *out);
+EAPI unsigned int etch_animation_sample_range(Etch_Animation *a, Etch_Time t0,
+		Etch_Time dt, unsigned int n, void *out);
+EAPI unsigned int etch_block_render(Etch_Animation **a, unsigned int count,
+		Etch_Time t0, unsigned int rate, unsigned int n, float **out);
 
 EAPI Etch_Animation_Keyframe * etch_animation_keyframe_add(Etch_Animation *a);
 EAPI void etch_animation_keyframe_remove(Etch_Animation *a, Etch_Animation_Keyframe *m);
@@ -260,7 +375,216 @@ EAPI void etch_animation_keyframe_value_set(Etch_Animation_Keyframe *k, Etch_Dat
 EAPI void etch_animation_keyframe_value_get(Etch_Animation_Keyframe *k, Etch_Data *v);
 EAPI void etch_animation_keyframe_cubic_value_set(Etch_Animation_Keyframe *k, double x0, double y0, double x1, double y1);
 EAPI void etch_animation_keyframe_quadratic_value_set(Etch_Animation_Keyframe *k, double x0, double y0);
+EAPI void etch_animation_keyframe_steps_value_set(Etch_Animation_Keyframe *k, unsigned int steps);
+EAPI void etch_animation_keyframe_spring_value_set(Etch_Animation_Keyframe *k, double stiffness, double damping, double velocity);
+
+/**
+ * @}
+ * @defgroup Etch_Command_Group Commands
+ * The animation and keyframe functions must be called from the same thread
+ * that ticks the Etch. Any other thread can post the modifications as
+ * commands instead, they are queued without locks and applied in one batch
+ * at the beginning of the next tick.
+ * @{
+ */
+
+/**
+ * Function called on the ticking thread for a posted call
+ * @param e The Etch instance
+ * @param data User provided data
+ */
+typedef void (*Etch_Command_Callback)(Etch *e, void *data);
+
+EAPI void etch_command_keyframe_value_set(Etch_Animation_Keyframe *k, Etch_Data *v);
+EAPI void etch_command_keyframe_time_set(Etch_Animation_Keyframe *k, Etch_Time t);
+EAPI void etch_command_keyframe_type_set(Etch_Animation_Keyframe *k, Etch_Interpolator_Type t);
+EAPI void etch_command_animation_enable(Etch_Animation *a);
+EAPI void etch_command_animation_disable(Etch_Animation *a);
+EAPI void etch_command_animation_remove(Etch *e, Etch_Animation *a);
+EAPI void etch_command_call(Etch *e, Etch_Command_Callback cb, void *data);
+EAPI void etch_command_flush(Etch *e);
+
 /**
  * @}
+ * @defgroup Etch_Snapshot_Group Snapshots
+ * The current value of an animation can only be read safely from the thread
+ * that ticks the Etch. When the snapshot is enabled every tick publishes a
+ * copy of all the animation values, any other thread can read a consistent
+ * view of them without locks and without blocking the ticking thread.
+ * @{
+ */
+EAPI void etch_snapshot_enable(Etch *e, unsigned int size);
+EAPI void etch_snapshot_disable(Etch *e);
+EAPI void etch_snapshot_read(Etch *e, Etch_Animation **a, unsigned int count,
+		Etch_Data *values, Etch_Time *t);
+
+/**
+ * @}
+ * @defgroup Etch_Executor_Group Executor
+ * An executor owns many Etch instances and ticks each of them at its own
+ * fps on a pool of threads. The instances are balanced between the threads
+ * by the time their ticks take.
+ * @{
  */
+typedef struct _Etch_Executor Etch_Executor; /**< Executor Opaque Handler */
+typedef struct _Etch_Executor_Instance Etch_Executor_Instance; /**< Executor Instance Opaque Handler */
+
+/**
+ * Function called when an Etch removed from an executor is no longer used
+ * @param e The Etch instance
+ * @param data User provided data
+ */
+typedef void (*Etch_Executor_Free)(Etch *e, void *data);
+
+EAPI Etch_Executor * etch_executor_new(unsigned int threads,
+		Etch_Executor_Free free, void *data);
+EAPI void etch_executor_delete(Etch_Executor *ex);
+EAPI Etch_Executor_Instance * etch_executor_add(Etch_Executor *ex, Etch *e);
+EAPI void etch_executor_remove(Etch_Executor *ex, Etch_Executor_Instance *inst);
+EAPI void etch_executor_instance_stats_get(Etch_Executor_Instance *inst,
+		Etch_Time *cost, unsigned int *missed);
+
+/**
+ * @}
+ * @defgroup Etch_Clock_Group Clock
+ * A clock drives an Etch from a main loop through a file descriptor that
+ * becomes readable on every frame. When nothing is being animated the
+ * clock only wakes up when the next animation starts.
+ * Only available on systems with timerfd.
+ * @{
+ */
+typedef struct _Etch_Clock Etch_Clock; /**< Clock Opaque Handler */
+
+EAPI Etch_Clock * etch_clock_new(Etch *e);
+EAPI void etch_clock_delete(Etch_Clock *c);
+EAPI int etch_clock_fd_get(Etch_Clock *c);
+EAPI void etch_clock_start(Etch_Clock *c);
+EAPI void etch_clock_stop(Etch_Clock *c);
+EAPI void etch_clock_update(Etch_Clock *c);
+EAPI unsigned int etch_clock_dispatch(Etch_Clock *c);
+EAPI unsigned long etch_clock_missed_get(Etch_Clock *c);
+/**
+ * @}
+ * @defgroup Etch_Export_Group Export
+ * An exporter publishes the values of some animations on a POSIX shared
+ * memory object after every tick, so other processes can read them without
+ * copies through the socket nor system calls. Every exported animation is
+ * assigned to a slot, the readers read the slots by index.
+ * Only available on systems with POSIX shared memory.
+ * @{
+ */
+typedef struct _Etch_Export Etch_Export; /**< Exporter Opaque Handler */
+typedef struct _Etch_Export_Reader Etch_Export_Reader; /**< Export Reader Opaque Handler */
+
+EAPI Etch_Export * etch_export_new(Etch *e, const char *name, unsigned int slots);
+EAPI void etch_export_delete(Etch_Export *ex);
+EAPI Eina_Bool etch_export_animation_set(Etch_Export *ex, unsigned int slot,
+		Etch_Animation *a);
+EAPI Etch_Export_Reader * etch_export_reader_new(const char *name);
+EAPI void etch_export_reader_delete(Etch_Export_Reader *r);
+EAPI unsigned int etch_export_reader_slots_get(Etch_Export_Reader *r);
+EAPI Eina_Bool etch_export_reader_read(Etch_Export_Reader *r, unsigned int first,
+		unsigned int count, Etch_Data *values, unsigned long *frame);
+/**
+ * @}
+ * @defgroup Etch_Event_Group Events
+ * Instead of calling the start, stop and repeat callbacks in the middle of
+ * the evaluation, every tick can queue those events together with the
+ * markers crossed, with the exact time they happened. The host drains them
+ * after the tick.
+ * @{
+ */
+typedef enum _Etch_Event_Type
+{
+	ETCH_EVENT_START, /**< The animation has started */
+	ETCH_EVENT_STOP, /**< The animation has finished all its repeats */
+	ETCH_EVENT_REPEAT, /**< The animation has started a new repeat */
+	ETCH_EVENT_MARKER, /**< A marker has been crossed */
+	ETCH_EVENT_TYPES
+} Etch_Event_Type;
+
+typedef struct _Etch_Event
+{
+	Etch_Event_Type type; /**< The type of the event */
+	Etch_Animation *animation; /**< The animation that sent the event */
+	Etch_Time time; /**< The time of the Etch when it happened */
+	int repeat; /**< The repeat of the animation, starting from zero */
+	const char *name; /**< The name of the marker */
+	void *data; /**< The data of the marker */
+} Etch_Event;
+
+EAPI void etch_events_enable(Etch *e, Eina_Bool enable);
+EAPI unsigned int etch_events_get(Etch *e, const Etch_Event **events);
+EAPI void etch_animation_marker_add(Etch_Animation *a, Etch_Time t,
+		const char *name, void *data);
+EAPI void etch_animation_marker_remove(Etch_Animation *a, const char *name);
+/**
+ * @}
+ * @defgroup Etch_Blend_Group Blend
+ * A blend accumulates the values of several animations of the same numeric
+ * or color data type into a single value. Every animation is a layer with a
+ * weight and a mode, the weight can be driven by another animation. The host
+ * receives one blended value per tick instead of one callback per layer.
+ * @{
+ */
+typedef struct _Etch_Blend Etch_Blend; /**< Blend Opaque Handler */
+
+typedef enum _Etch_Blend_Mode
+{
+	ETCH_BLEND_OVERRIDE, /**< Interpolate from the layers below to the value by the weight */
+	ETCH_BLEND_ADDITIVE, /**< Add the value scaled by the weight to the layers below */
+	ETCH_BLEND_MODES
+} Etch_Blend_Mode;
+
+typedef void (*Etch_Blend_Callback)(Etch_Blend *b, const Etch_Data *value, void *data);
+
+EAPI Etch_Blend * etch_blend_add(Etch *e, Etch_Data_Type dtype,
+		Etch_Blend_Callback cb, void *data);
+EAPI void etch_blend_delete(Etch_Blend *b);
+EAPI int etch_blend_layer_add(Etch_Blend *b, Etch_Animation *a,
+		Etch_Blend_Mode mode, double weight);
+EAPI void etch_blend_layer_weight_set(Etch_Blend *b, unsigned int layer, double weight);
+EAPI Eina_Bool etch_blend_layer_weight_animate(Etch_Blend *b, unsigned int layer,
+		Etch_Animation *w);
+EAPI void etch_blend_value_get(Etch_Blend *b, Etch_Data *v);
+/**
+ * @}
+ * @defgroup Etch_Checkpoint_Group Checkpoint
+ * A checkpoint captures the playback state of every animation of an Etch,
+ * the current time and frame, on a single block of memory. Restoring it
+ * brings the Etch back to that exact state, including whenever the
+ * animations had started and their current and previous values.
+ * @{
+ */
+typedef struct _Etch_Checkpoint Etch_Checkpoint; /**< Checkpoint Opaque Handler */
+
+EAPI Etch_Checkpoint * etch_checkpoint_save(Etch *e, const Etch_Checkpoint *base);
+EAPI Eina_Bool etch_checkpoint_restore(Etch *e, const Etch_Checkpoint *c);
+EAPI void etch_checkpoint_free(Etch_Checkpoint *c);
+EAPI size_t etch_checkpoint_size_get(const Etch_Checkpoint *c);
+/**
+ * @}
+ * @defgroup Etch_Record_Group Record
+ * The calls made on an Etch can be logged to a compact binary file with
+ * their timing, and replayed later on a new Etch. This allows reproducing
+ * the workload of a real application to benchmark or profile the library.
+ * @{
+ */
+typedef struct _Etch_Replay Etch_Replay; /**< Replay Opaque Handler */
+
+EAPI Eina_Bool etch_record_start(Etch *e, const char *file);
+EAPI void etch_record_stop(Etch *e);
+EAPI Etch_Replay * etch_replay_new(const char *file);
+EAPI void etch_replay_delete(Etch_Replay *r);
+EAPI Etch * etch_replay_etch_get(Etch_Replay *r);
+EAPI Eina_Bool etch_replay_next_time_get(Etch_Replay *r, Etch_Time *t);
+EAPI Eina_Bool etch_replay_step(Etch_Replay *r, Etch_Time *t, Eina_Bool *timer);
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /*ETCH_H_*/
@@ -0,0 +1,472 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ETCH_HH_
+#define ETCH_HH_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "Etch.h"
+
+/**
+ * @file
+ * @brief Etch C++ API
+ * A header only C++17 layer over the C API. An etch::Animation<T, Easing>
+ * is an external animation of the C library whose interpolator is
+ * instantiated for the value type and the easing, so the easing and the
+ * interpolation of the values are inlined on a single function. The
+ * keyframes, the playback state and the timing still live on the C
+ * library, the C++ objects only own them.
+ */
+namespace etch {
+
+using Time = Etch_Time;
+
+constexpr Time second = ETCH_SECOND;
+constexpr Time msecond = ETCH_MSECOND;
+
+/**
+ * Color of 32 bits, interpolated per channel like ETCH_ARGB
+ */
+struct Argb
+{
+	uint32_t value;
+};
+
+/**
+ * How the values of a type are interpolated. The default needs the type to
+ * support a + (b - a) * m, specialize it for any other type
+ */
+template <typename T>
+struct Traits
+{
+	static T interpolate(const T &a, const T &b, double m)
+	{
+		return a + (b - a) * m;
+	}
+};
+
+template <>
+struct Traits<double>
+{
+	static double interpolate(double a, double b, double m)
+	{
+		double r;
+
+		etch_interpolate_double(a, b, m, &r);
+		return r;
+	}
+};
+
+template <>
+struct Traits<float>
+{
+	static float interpolate(float a, float b, double m)
+	{
+		float r;
+
+		etch_interpolate_float(a, b, m, &r);
+		return r;
+	}
+};
+
+template <>
+struct Traits<int32_t>
+{
+	static int32_t interpolate(int32_t a, int32_t b, double m)
+	{
+		int32_t r;
+
+		etch_interpolate_int32(a, b, m, &r);
+		return r;
+	}
+};
+
+template <>
+struct Traits<uint32_t>
+{
+	static uint32_t interpolate(uint32_t a, uint32_t b, double m)
+	{
+		uint32_t r;
+
+		etch_interpolate_uint32(a, b, m, &r);
+		return r;
+	}
+};
+
+template <>
+struct Traits<Argb>
+{
+	static Argb interpolate(Argb a, Argb b, double m)
+	{
+		Argb r;
+
+		etch_interpolate_argb(a.value, b.value, m, &r.value);
+		return r;
+	}
+};
+
+/**
+ * The easings map the position between two keyframes, in [0, 1], to the
+ * interpolation factor. Every easing is a type with a constexpr apply()
+ */
+namespace easing {
+
+struct Linear
+{
+	static constexpr double apply(double m) { return m; }
+};
+
+struct Discrete
+{
+	static constexpr double apply(double m) { return m < 1 ? 0 : 1; }
+};
+
+struct Smoothstep
+{
+	static constexpr double apply(double m) { return m * m * (3 - 2 * m); }
+};
+
+struct QuadIn
+{
+	static constexpr double apply(double m) { return m * m; }
+};
+
+struct QuadOut
+{
+	static constexpr double apply(double m) { return m * (2 - m); }
+};
+
+struct QuadInOut
+{
+	static constexpr double apply(double m)
+	{
+		return m < 0.5 ? 2 * m * m : 1 - 2 * (1 - m) * (1 - m);
+	}
+};
+
+struct CubicIn
+{
+	static constexpr double apply(double m) { return m * m * m; }
+};
+
+struct CubicOut
+{
+	static constexpr double apply(double m)
+	{
+		return 1 - (1 - m) * (1 - m) * (1 - m);
+	}
+};
+
+struct CubicInOut
+{
+	static constexpr double apply(double m)
+	{
+		return m < 0.5 ? 4 * m * m * m : 1 - 4 * (1 - m) * (1 - m) * (1 - m);
+	}
+};
+
+/**
+ * Discrete steps of the same length
+ */
+template <unsigned int N>
+struct Steps
+{
+	static_assert(N > 0, "At least one step is needed");
+	static constexpr double apply(double m)
+	{
+		return m < 1 ? static_cast<unsigned int>(m * N) / static_cast<double>(N) : 1;
+	}
+};
+
+/**
+ * Cubic bezier with the control points of P, a type with the static
+ * constexpr doubles x0, y0, x1 and y1, like the CSS timing functions. The
+ * curve is solved on every evaluation, use it through a Table
+ */
+template <typename P>
+struct Bezier
+{
+	static constexpr double _x(double t)
+	{
+		return ((1 + 3 * P::x0 - 3 * P::x1) * t + 3 * P::x1 - 6 * P::x0) * t * t + 3 * P::x0 * t;
+	}
+
+	static constexpr double _y(double t)
+	{
+		return ((1 + 3 * P::y0 - 3 * P::y1) * t + 3 * P::y1 - 6 * P::y0) * t * t + 3 * P::y0 * t;
+	}
+
+	static constexpr double apply(double m)
+	{
+		double lo = 0;
+		double hi = 1;
+
+		/* x(t) is monotonic for control points in [0, 1] */
+		for (int i = 0; i < 40; i++)
+		{
+			double mid = (lo + hi) / 2;
+
+			if (_x(mid) < m)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return _y((lo + hi) / 2);
+	}
+};
+
+struct EasePoints { static constexpr double x0 = 0.25, y0 = 0.1, x1 = 0.25, y1 = 1; };
+struct EaseInPoints { static constexpr double x0 = 0.42, y0 = 0, x1 = 1, y1 = 1; };
+struct EaseOutPoints { static constexpr double x0 = 0, y0 = 0, x1 = 0.58, y1 = 1; };
+struct EaseInOutPoints { static constexpr double x0 = 0.42, y0 = 0, x1 = 0.58, y1 = 1; };
+
+/**
+ * An easing sampled at compile time on N segments and linearly
+ * interpolated, for the easings that are expensive to evaluate
+ */
+template <typename Easing, unsigned int N = 256>
+struct Table
+{
+	static_assert(N > 0, "At least one segment is needed");
+
+	static constexpr std::array<double, N + 1> _build()
+	{
+		std::array<double, N + 1> s{};
+
+		for (unsigned int i = 0; i <= N; i++)
+			s[i] = Easing::apply(static_cast<double>(i) / N);
+		return s;
+	}
+
+	static constexpr std::array<double, N + 1> samples = _build();
+
+	static constexpr double apply(double m)
+	{
+		if (m <= 0)
+			return samples[0];
+		if (m >= 1)
+			return samples[N];
+		double x = m * N;
+		unsigned int i = static_cast<unsigned int>(x);
+		return samples[i] + (samples[i + 1] - samples[i]) * (x - i);
+	}
+};
+
+using Ease = Table<Bezier<EasePoints>>;
+using EaseIn = Table<Bezier<EaseInPoints>>;
+using EaseOut = Table<Bezier<EaseOutPoints>>;
+using EaseInOut = Table<Bezier<EaseInOutPoints>>;
+
+} /* namespace easing */
+
+/**
+ * Initialize the library for the lifetime of the object
+ */
+struct Init
+{
+	Init() { etch_init(); }
+	~Init() { etch_shutdown(); }
+	Init(const Init &) = delete;
+	Init &operator=(const Init &) = delete;
+};
+
+/**
+ * Owner of an Etch. It must outlive its animations
+ */
+class Timeline
+{
+public:
+	Timeline() : _e(etch_new()) {}
+	~Timeline() { if (_e) etch_delete(_e); }
+
+	Timeline(const Timeline &) = delete;
+	Timeline &operator=(const Timeline &) = delete;
+	Timeline(Timeline &&o) noexcept : _e(std::exchange(o._e, nullptr)) {}
+	Timeline &operator=(Timeline &&o) noexcept
+	{
+		std::swap(_e, o._e);
+		return *this;
+	}
+
+	void fps_set(unsigned int fps) { etch_timer_fps_set(_e, fps); }
+	unsigned int fps_get() const { return etch_timer_fps_get(_e); }
+	void tick() { etch_timer_tick(_e); }
+	void tick(Time budget, Etch_Tick_Report *r = nullptr) { etch_timer_tick_budget(_e, budget, r); }
+	void timer_set(Time t) { etch_timer_set(_e, t); }
+	Time timer_get() const
+	{
+		Time t;
+
+		etch_timer_get(_e, &t);
+		return t;
+	}
+	void timer_goto(unsigned long frame) { etch_timer_goto(_e, frame); }
+	void flush() { etch_flush(_e); }
+
+	/** The C instance */
+	::Etch *get() const { return _e; }
+
+private:
+	::Etch *_e;
+};
+
+/**
+ * Animation of values of type T with an easing between every pair of
+ * keyframes. On every change the value is stored on the bound variable or
+ * given to the sink. T must be default constructible and copyable
+ */
+template <typename T, typename Easing = easing::Linear>
+class Animation
+{
+public:
+	using Sink = std::function<void(const T &)>;
+
+	explicit Animation(Timeline &t) : Animation(t.get()) {}
+	explicit Animation(::Etch *e) : _slot(new Slot())
+	{
+		_slot->animation = etch_animation_external_add(e, _interpolate,
+				_changed, nullptr, nullptr, nullptr, nullptr,
+				&_slot->value, _slot.get());
+	}
+	~Animation() { _release(); }
+
+	Animation(const Animation &) = delete;
+	Animation &operator=(const Animation &) = delete;
+	Animation(Animation &&) noexcept = default;
+	Animation &operator=(Animation &&o) noexcept
+	{
+		_release();
+		_slot = std::move(o._slot);
+		return *this;
+	}
+
+	/**
+	 * Add a keyframe. As with the C API a keyframe at time zero must be
+	 * added before the others
+	 * @param t The time of the keyframe
+	 * @param v The value of the keyframe
+	 */
+	Animation &keyframe(Time t, const T &v)
+	{
+		Etch_Animation_Keyframe *k;
+		Etch_Data d;
+		T *p;
+
+		k = etch_animation_keyframe_add(_slot->animation);
+		p = new T(v);
+		/* the keyframe owns the value */
+		etch_animation_keyframe_data_set(k, p, _free);
+		d.type = ETCH_EXTERNAL;
+		d.data.external = p;
+		etch_animation_keyframe_value_set(k, &d);
+		/* the easing is applied by the interpolator */
+		etch_animation_keyframe_type_set(k, ETCH_INTERPOLATOR_LINEAR);
+		etch_animation_keyframe_time_set(k, t);
+		return *this;
+	}
+
+	/** Give every new value to a function */
+	Animation &sink(Sink s)
+	{
+		_slot->sink = std::move(s);
+		_slot->dst = nullptr;
+		return *this;
+	}
+
+	/** Give every new value to a member function of an object */
+	template <typename O>
+	Animation &sink(O *o, void (O::*m)(const T &))
+	{
+		return sink([o, m](const T &v) { (o->*m)(v); });
+	}
+
+	/** Store every new value on a variable, no function is called */
+	Animation &bind(T &dst)
+	{
+		_slot->dst = &dst;
+		_slot->sink = nullptr;
+		return *this;
+	}
+
+	Animation &enable() { etch_animation_enable(_slot->animation); return *this; }
+	Animation &disable() { etch_animation_disable(_slot->animation); return *this; }
+	bool enabled() const { return etch_animation_enabled(_slot->animation); }
+	Animation &repeat(int times) { etch_animation_repeat_set(_slot->animation, times); return *this; }
+	Animation &offset(Time t) { etch_animation_offset_add(_slot->animation, t); return *this; }
+	Animation &direction(Etch_Animation_Direction d) { etch_animation_direction_set(_slot->animation, d); return *this; }
+	Animation &priority(Etch_Priority p) { etch_animation_priority_set(_slot->animation, p); return *this; }
+
+	/** The last evaluated value */
+	const T &value() const { return _slot->value; }
+	/** The C animation */
+	Etch_Animation *get() const { return _slot->animation; }
+
+private:
+	/* the C animation points to it, so it does not move with the object */
+	struct Slot
+	{
+		Etch_Animation *animation = nullptr;
+		T value{};
+		T *dst = nullptr;
+		Sink sink;
+	};
+
+	std::unique_ptr<Slot> _slot;
+
+	void _release()
+	{
+		if (_slot && _slot->animation)
+			etch_animation_delete(_slot->animation);
+		_slot.reset();
+	}
+
+	static void _free(void *p)
+	{
+		delete static_cast<T *>(p);
+	}
+
+	/* the per type evaluation, the easing and the interpolation are
+	 * inlined here */
+	static void _interpolate(Etch_Data *a, Etch_Data *b, double m,
+			Etch_Data *res, void *)
+	{
+		*static_cast<T *>(res->data.external) = Traits<T>::interpolate(
+				*static_cast<const T *>(a->data.external),
+				*static_cast<const T *>(b->data.external),
+				Easing::apply(m));
+	}
+
+	static void _changed(Etch_Animation_Keyframe *, const Etch_Data *,
+			const Etch_Data *, void *data)
+	{
+		Slot *s = static_cast<Slot *>(data);
+
+		if (s->dst)
+			*s->dst = s->value;
+		else if (s->sink)
+			s->sink(s->value);
+	}
+};
+
+} /* namespace etch */
+
+#endif /*ETCH_HH_*/
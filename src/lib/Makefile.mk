@@ -3,23 +3,40 @@ lib_LTLIBRARIES = src/lib/libetch.la
 
 installed_headersdir = $(pkgincludedir)-$(VMAJ)
 dist_installed_headers_DATA = \
-src/lib/Etch.h
+src/lib/Etch.h \
+src/lib/Etch.hh
 
 src_lib_libetch_la_SOURCES = \
 src/lib/etch.c \
 src/lib/etch_animation.c \
-src/lib/etch_interpolator_argb.c \
-src/lib/etch_interpolator_string.c \
-src/lib/etch_interpolator_uint32.c \
-src/lib/etch_interpolator_int32.c \
-src/lib/etch_interpolator_float.c \
-src/lib/etch_interpolator_double.c \
+src/lib/etch_blend.c \
+src/lib/etch_checkpoint.c \
+src/lib/etch_command.c \
+src/lib/etch_event.c \
+src/lib/etch_executor.c \
+src/lib/etch_interpolator.c \
+src/lib/etch_record.c \
+src/lib/etch_sample.c \
+src/lib/etch_snapshot.c \
+src/lib/etch_track.c \
 src/lib/etch_private.h
 
+if ETCH_HAVE_TIMERFD
+src_lib_libetch_la_SOURCES += src/lib/etch_clock.c
+endif
+
+if ETCH_HAVE_SHM
+src_lib_libetch_la_SOURCES += src/lib/etch_export.c
+endif
+
 src_lib_libetch_la_CPPFLAGS = \
 -DETCH_BUILD \
 @ETCH_CFLAGS@
 
+if ETCH_HAVE_SHM
+src_lib_libetch_la_CPPFLAGS += -DETCH_HAVE_SHM
+endif
+
 src_lib_libetch_la_LIBADD = \
 @ETCH_LIBS@ \
 -lm
@@ -18,6 +18,8 @@
 #include "Etch.h"
 #include "etch_private.h"
 
+#include <time.h>
+
 /**
  * TODO
  * + maybe a function to call whenever the fps timer has match? like:
@@ -39,6 +41,7 @@ static Etch_Interpolator _interpolators[ETCH_DATATYPES] = {
 };
 
 #define DEFAULT_FPS 30
+#define DECIMATION_MAX 16
 
 static int _init_count = 0;
 
@@ -47,30 +50,239 @@ static void _fps_to_time(unsigned long frame, unsigned long *time)
 	/* giving a frame transform it to secs|usec representation */
 }
 
-static void _process(Etch *e)
+static Etch_Time _now(void)
 {
-	Etch_Animation *a;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Etch_Time)ts.tv_sec * ETCH_SECOND + ts.tv_nsec;
+}
 
-	/* iterate over the list of animations */
-	EINA_INLIST_FOREACH(e->animations, a)
+/* Get the time of the Etch where a running animation leaves the segment
+ * where its value does not change, if it is on one */
+static Eina_Bool _hold_next_get(Etch *e, unsigned int index, Etch_Time *t)
+{
+	Etch_Animation_State *a = &e->states[index];
+	Etch_Time length, atime, pos, rcurr;
+
+	/* the lazy ones need the time of every tick, the markers need the
+	 * ticks to be sent */
+	if (!a->started || a->lazy || a->hold_start >= a->hold_end)
+		return EINA_FALSE;
+	if (e->events.enabled && e->animations[index]->markers_count)
+		return EINA_FALSE;
+	length = a->end - a->start;
+	atime = e->curr - (a->start + a->offset);
+	pos = atime % length;
+	if (a->direction == ETCH_ANIMATION_REVERSE ||
+			(a->direction == ETCH_ANIMATION_ALTERNATE && ((atime / length) & 1)))
 	{
-		etch_animation_process(a);
+		rcurr = a->end - pos;
+		if (rcurr < a->hold_start || rcurr >= a->hold_end)
+			return EINA_FALSE;
+		*t = e->curr + rcurr - a->hold_start + 1;
+		return EINA_TRUE;
 	}
+	rcurr = a->start + pos;
+	if (rcurr < a->hold_start || rcurr >= a->hold_end)
+		return EINA_FALSE;
+	*t = e->curr + a->hold_end - rcurr;
+	return EINA_TRUE;
+}
+
+/* In case of rates, an animation of a decimated priority is only evaluated
+ * every rate ticks, the animations of the same priority are staggered over
+ * those ticks to spread the load */
+static void _process(Etch *e, const unsigned int *rates, Etch_Tick_Report *r)
+{
+	unsigned int i, n;
+
+	if (e->events.enabled)
+	{
+		e->events.count = 0;
+		for (i = 0; i < e->count; i++)
+			etch_event_queue_collect(e, i);
+		etch_event_queue_end(e);
+	}
+	/* iterate over the array of animations */
+	for (i = 0; i < e->count; i++)
+	{
+		Etch_Time step = e->tpf;
+
+		if (rates)
+		{
+			Etch_Priority p = e->states[i].priority;
+
+			/* the position among the animations of its priority */
+			n = e->priority_count[p]++;
+			if (rates[p] > 1 && (e->frame + n) % rates[p])
+			{
+				r->priority_deferred[p]++;
+				continue;
+			}
+			/* the rates change between ticks, use the real step */
+			if (e->states[i].processed < e->curr)
+				step = e->curr - e->states[i].processed;
+		}
+		etch_animation_process(e, i, step);
+	}
+	if (e->blends_count)
+		etch_blend_process(e);
+	if (e->snapshot)
+		etch_snapshot_publish(e);
+#ifdef ETCH_HAVE_SHM
+	if (e->export)
+		etch_export_publish(e->export);
+#endif
 }
 /*============================================================================*
  *                                 Global                                     *
  *============================================================================*/
 int etch_log_dom_global = -1;
 
-void etch_animation_process(Etch_Animation *a)
+/* Get a new id for an animation, the ids of deleted animations are reused
+ * to keep them dense */
+unsigned int etch_id_new(Etch *e)
+{
+	if (e->free_ids_count)
+		return e->free_ids[--e->free_ids_count];
+	return e->ids++;
+}
+
+/* Mark an animation to be evaluated again at the time of its last
+ * evaluation */
+void etch_animation_dirty(Etch_Animation *a)
+{
+	Etch *e = a->etch;
+	Etch_Animation_State *s = etch_animation_state_get(a);
+
+	/* the value might change anywhere now */
+	s->hold_start = s->hold_end = 0;
+	if (a->dirty)
+		return;
+	if (e->dirty_count == e->dirty_size)
+	{
+		e->dirty_size = e->dirty_size ? e->dirty_size * 2 : 16;
+		e->dirty = realloc(e->dirty, sizeof(Etch_Animation *) * e->dirty_size);
+	}
+	e->dirty[e->dirty_count++] = a;
+	a->dirty = EINA_TRUE;
+}
+
+/* Evaluate again every dirty animation that is on the Etch and enabled.
+ * Right before a tick the running animations are going to be evaluated
+ * anyway, so only the rest are evaluated unless all is set */
+void etch_dirty_process(Etch *e, Eina_Bool all)
+{
+	unsigned int i;
+
+	/* the callbacks might modify other keyframes, those are evaluated on
+	 * this same pass */
+	for (i = 0; i < e->dirty_count; i++)
+	{
+		Etch_Animation *a = e->dirty[i];
+		Etch_Animation_State *s;
+
+		a->dirty = EINA_FALSE;
+		if (a->detached)
+			continue;
+		s = &e->states[a->index];
+		if (!s->enabled || (s->started && !all))
+			continue;
+		/* the skipped ticks did not update the time of the evaluation */
+		etch_animation_animate(a, s, s->held ?
+				etch_animation_time_map(s, s->processed) : a->last);
+	}
+	e->dirty_count = 0;
+}
+
+/* Get the time of the next tick where something will be animated. In case
+ * an animation is running that is the next frame, unless its value does not
+ * change until the end of its current segment. Otherwise it is the start of
+ * the first animation that has not started yet or the first end of a
+ * segment */
+Eina_Bool etch_next_event_get(Etch *e, Etch_Time *t)
 {
+	Eina_Bool found = EINA_FALSE;
+	Etch_Time next = 0;
+	unsigned int i;
+
+	for (i = 0; i < e->count; i++)
+	{
+		Etch_Animation_State *a = &e->states[i];
+		Etch_Time start;
+
+		if (!a->enabled || !(a->end - a->start) ||
+				(!e->animations[i]->keys && !e->animations[i]->track))
+			continue;
+		start = a->start + a->offset;
+		if (e->curr < start)
+		{
+			if (!found || start < next)
+				next = start;
+			found = EINA_TRUE;
+			continue;
+		}
+		/* finished and already stopped */
+		if (a->repeat >= 0 && !a->started &&
+				e->curr > (a->end * a->repeat) + a->offset)
+			continue;
+		if (_hold_next_get(e, i, &start))
+		{
+			if (!found || start < next)
+				next = start;
+			found = EINA_TRUE;
+			continue;
+		}
+		*t = e->curr + e->tpf;
+		return EINA_TRUE;
+	}
+	if (found) *t = next;
+	return found;
+}
+
+/* Add the animation state to the array of states */
+void etch_animation_append(Etch *e, Etch_Animation *a)
+{
+	if (e->count == e->size)
+	{
+		e->size = e->size ? e->size * 2 : 32;
+		e->states = realloc(e->states, sizeof(Etch_Animation_State) * e->size);
+		e->animations = realloc(e->animations, sizeof(Etch_Animation *) * e->size);
+	}
+	a->index = e->count++;
+	e->layout++;
+	if (a->kernels)
+		a->kernels = etch_kernels[e->precision][a->dtype];
+	e->states[a->index] = *a->detached;
+	e->animations[a->index] = a;
+	free(a->detached);
+	a->detached = NULL;
+}
+
+void etch_id_free(Etch *e, unsigned int id)
+{
+	if (e->free_ids_count == e->free_ids_size)
+	{
+		e->free_ids_size = e->free_ids_size ? e->free_ids_size * 2 : 16;
+		e->free_ids = realloc(e->free_ids, sizeof(unsigned int) * e->free_ids_size);
+	}
+	e->free_ids[e->free_ids_count++] = id;
+}
+
+/* Process an animation, step is the time since its previous evaluation */
+void etch_animation_process(Etch *e, unsigned int index, Etch_Time step)
+{
+	Etch_Animation_State *a;
+	Etch_Animation *anim;
 	Etch_Time rcurr;
 	Etch_Time atime; /* animation time */
 	Etch_Time end;
 	Etch_Time length;
-	Etch *e;
 
-	e = a->etch;
+	/* only the state is needed until something has to be animated */
+	a = &e->states[index];
+	a->processed = e->curr;
 	/* TODO use e->start and e->end */
 	DBG("[%" ETCH_TIME_FORMAT " %" ETCH_TIME_FORMAT "]"
 			" %" ETCH_TIME_FORMAT \
@@ -99,54 +311,64 @@ void etch_animation_process(Etch_Animation *a)
 	{
 		if (a->started)
 		{
+			anim = e->animations[index];
 			DBG("Stopping animation %p at %" ETCH_TIME_FORMAT
 					" with end %" ETCH_TIME_FORMAT,
-					a,
+					anim,
 					ETCH_TIME_ARGS (e->curr),
 					ETCH_TIME_ARGS (a->end));
 			/* send the last tick that will trigger the animation
 			 * for the end value
 			 */
-			etch_animation_animate(a, a->end);
 			a->started = EINA_FALSE;
-			if (a->stop_cb) a->stop_cb(a, a->data);
+			etch_animation_animate(anim, a, etch_animation_time_map(a, e->curr));
+			if (anim->stop_cb && !e->events.enabled)
+				anim->stop_cb(anim, anim->data);
 		}
 		return;
 	}
 infinite:
-	/* normalize to animation time */
-	atime = e->curr - (a->start + a->offset);
-
-	/* ok we are on the range */
-	/* calculate the relative current time */
-	length = a->end - a->start;
-	rcurr = atime % length;
-	rcurr += a->start;
+	/* ok we are on the range, calculate the relative current time */
+	rcurr = etch_animation_time_map(a, e->curr);
+	anim = e->animations[index];
 	/* if the previous tick was outside the start-end
 	 * means that we are going to repeat
 	 */
-	if (((rcurr - e->tpf) < a->start) && a->started)
+	atime = e->curr - (a->start + a->offset);
+	length = a->end - a->start;
+	if (atime >= length && (atime % length) < step && a->started)
 	{
-		DBG("Repeating animation %p", a);
+		DBG("Repeating animation %p", anim);
 		/* force it to pass through the last keyframe on the repeat */ 
-		etch_animation_animate(a, a->end);
-		if (a->repeat_cb) a->repeat_cb(a, a->data);
+		etch_animation_animate(anim, a,
+				etch_animation_time_position(a, atime / length - 1, length));
+		if (anim->repeat_cb && !e->events.enabled)
+			anim->repeat_cb(anim, anim->data);
 		return;
 	}
 
 	if (!a->started)
 	{
-		DBG("Starting animation %p", a);
-		if (a->start_cb) a->start_cb(a, a->data);
+		DBG("Starting animation %p", anim);
+		/* the callback might add animations and move the states */
 		a->started = EINA_TRUE;
+		if (anim->start_cb && !e->events.enabled)
+			anim->start_cb(anim, anim->data);
+		a = &e->states[index];
 	}
 
+	/* the value does not change until the end of the held segment */
+	if (rcurr >= a->hold_start && rcurr < a->hold_end)
+	{
+		a->held = EINA_TRUE;
+		return;
+	}
 	DBG("Animating at %" ETCH_TIME_FORMAT " for [%" 
 			ETCH_TIME_FORMAT " %" ETCH_TIME_FORMAT "]",
 			ETCH_TIME_ARGS (rcurr),
 			ETCH_TIME_ARGS (a->start),
 			ETCH_TIME_ARGS (a->end));
-	etch_animation_animate(a, rcurr);
+	etch_animation_animate(anim, a, rcurr);
 }
 
 /*============================================================================*
@@ -194,6 +416,7 @@ EAPI Etch * etch_new(void)
 	Etch *e;
 
 	e = calloc(1, sizeof(Etch));
+	etch_command_queue_init(&e->commands);
 	etch_timer_fps_set(e, DEFAULT_FPS);
 	return e;
 }
@@ -205,8 +428,22 @@ EAPI Etch * etch_new(void)
 EAPI void etch_delete(Etch *e)
 {
 	assert(e);
+	etch_record_shutdown(e);
 	/* remove every object */
 	/* TODO remove every animation */
+	etch_command_queue_shutdown(&e->commands);
+	etch_event_queue_shutdown(&e->events);
+	etch_blend_shutdown(e);
+#ifdef ETCH_HAVE_SHM
+	if (e->export)
+		etch_export_delete(e->export);
+#endif
+	free(e->states);
+	free(e->animations);
+	if (e->snapshot)
+		etch_snapshot_free(e->snapshot);
+	free(e->free_ids);
+	free(e->dirty);
 	free(e);
 }
 /**
@@ -223,6 +460,8 @@ EAPI void etch_timer_fps_set(Etch *e, unsigned int fps)
 	e->fps = fps;
 	spf = (double)1.0/fps;
 	e->tpf = spf * ETCH_SECOND;
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_TIMER_FPS, fps);
 }
 /**
  * Sets the frames per second
@@ -234,6 +473,39 @@ EAPI unsigned int etch_timer_fps_get(Etch *e)
 	assert(e);
 	return e->fps;
 }
+/**
+ * Sets the precision of the interpolators
+ * @param e The Etch instance
+ * @param p The precision
+ */
+EAPI void etch_precision_set(Etch *e, Etch_Precision p)
+{
+	unsigned int i;
+
+	assert(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_PRECISION, p);
+	if (p >= ETCH_PRECISIONS)
+		return;
+	e->precision = p;
+	for (i = 0; i < e->count; i++)
+	{
+		Etch_Animation *a = e->animations[i];
+
+		if (a->kernels)
+			a->kernels = etch_kernels[p][a->dtype];
+	}
+}
+/**
+ * Gets the precision of the interpolators
+ * @param e The Etch instance
+ * @return The precision
+ */
+EAPI Etch_Precision etch_precision_get(Etch *e)
+{
+	assert(e);
+	return e->precision;
+}
 /**
  * Advance the global time by one unit of seconds per frame
  * @param e The Etch instance
@@ -242,9 +514,76 @@ EAPI void etch_timer_tick(Etch *e)
 {
 	assert(e);
 	/* TODO check for overflow */
+	etch_command_queue_process(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_TIMER_TICK, 0);
+	etch_dirty_process(e, EINA_FALSE);
 	e->frame++;
 	e->curr += e->tpf;
-	_process(e);
+	_process(e, NULL, NULL);
+}
+/**
+ * Advance the global time by one unit of seconds per frame, trying to not
+ * spend more than a time budget. When the estimated cost of the tick is over
+ * the budget the animations of the lowest priorities are evaluated every
+ * 2, 4, 8 or 16 ticks, starting with ETCH_PRIORITY_BACKGROUND and never
+ * decimating ETCH_PRIORITY_HIGH. A deferred animation is evaluated at the
+ * time of the tick it runs on, so its timing is kept. The estimate is the
+ * average cost of an evaluation on the previous ticks with a budget
+ * @param e The Etch instance
+ * @param budget The time budget of the tick, zero for no budget
+ * @param r The location to store the report of the tick, can be NULL
+ */
+EAPI void etch_timer_tick_budget(Etch *e, Etch_Time budget, Etch_Tick_Report *r)
+{
+	Etch_Tick_Report report;
+	Etch_Time start;
+	Etch_Time estimate = 0;
+	unsigned int count = 0;
+	int p;
+
+	assert(e);
+	if (!r)
+		r = &report;
+	memset(r, 0, sizeof(Etch_Tick_Report));
+	for (p = 0; p < ETCH_PRIORITIES; p++)
+	{
+		r->rates[p] = 1;
+		estimate += e->eval_cost * e->priority_count[p];
+	}
+	/* halve the evaluations of the lowest priority until the tick fits */
+	for (p = ETCH_PRIORITIES - 1; budget && p > ETCH_PRIORITY_HIGH; p--)
+	{
+		while (estimate > budget && r->rates[p] < DECIMATION_MAX)
+		{
+			estimate -= e->eval_cost * e->priority_count[p] / (r->rates[p] * 2);
+			r->rates[p] *= 2;
+		}
+	}
+
+	start = _now();
+	etch_command_queue_process(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_TIMER_TICK_BUDGET, budget);
+	etch_dirty_process(e, EINA_FALSE);
+	e->frame++;
+	e->curr += e->tpf;
+	memset(e->priority_count, 0, sizeof(e->priority_count));
+	_process(e, r->rates, r);
+	r->cost = _now() - start;
+
+	for (p = 0; p < ETCH_PRIORITIES; p++)
+	{
+		r->deferred += r->priority_deferred[p];
+		count += e->priority_count[p];
+	}
+	r->evaluated = count - r->deferred;
+	if (r->evaluated)
+	{
+		Etch_Time cost = r->cost / r->evaluated;
+
+		e->eval_cost = e->eval_cost ? (e->eval_cost * 7 + cost) / 8 : cost;
+	}
 }
 /**
  * Query whenever all animations are done
@@ -275,8 +614,12 @@ EAPI void etch_timer_get(Etch *e, Etch_Time *t)
  */
 EAPI void etch_timer_set(Etch *e, Etch_Time t)
 {
+	etch_command_queue_process(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_TIMER_SET, t);
+	etch_dirty_process(e, EINA_FALSE);
 	e->curr = t;
-	_process(e);
+	_process(e, NULL, NULL);
 }
 
 /**
@@ -288,16 +631,42 @@ EAPI void etch_timer_goto(Etch *e, unsigned long frame)
 {
 	Etch_Time t;
 
+	etch_command_queue_process(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_TIMER_GOTO, frame);
+	etch_dirty_process(e, EINA_FALSE);
 	e->frame = frame;
 	t = e->tpf * frame;
 	e->curr = t;
-	_process(e);
+	_process(e, NULL, NULL);
+}
+/**
+ * Evaluate again every animation whose keyframes have been modified since
+ * it was evaluated, at the time of that evaluation. Only the animations
+ * where the modified keyframes are on the evaluated segment are evaluated.
+ * This is also done before the next tick, no need to call it if the
+ * timer is going to be moved anyway
+ * @param e The Etch instance
+ */
+EAPI void etch_flush(Etch *e)
+{
+	assert(e);
+	if (e->record)
+		etch_record_timer(e, ETCH_RECORD_FLUSH, 0);
+	if (!e->dirty_count)
+		return;
+	etch_dirty_process(e, EINA_TRUE);
+	if (e->blends_count)
+		etch_blend_process(e);
+	if (e->snapshot)
+		etch_snapshot_publish(e);
 }
 /**
  * Create a new animation
  * @param e The Etch instance to add the animation to
  * @param dtype Data type the animation will animate
- * @param cb Function called whenever the value changes
+ * @param cb Function called whenever the value changes, can be NULL for
+ * animations that are going to be bound with etch_animation_bind()
  * @param start Function called whenever the animation starts
  * @param stop Function called whenever the animation stops
  * @param data User provided data that passed to the callbacks
@@ -318,7 +687,9 @@ EAPI Etch_Animation * etch_animation_add(Etch *e, Etch_Data_Type dtype,
 	interpolator = _interpolators[dtype];
 	a = etch_animation_new(e, dtype, interpolator, cb, start, stop, repeat, NULL, NULL, data);
 	if (!a) return NULL;
-	e->animations = eina_inlist_append(e->animations, EINA_INLIST_GET(a));
+	etch_animation_append(e, a);
+	if (e->record)
+		etch_record_animation_add(a);
 
 	return a;
 }
@@ -347,7 +718,7 @@ EAPI Etch_Animation * etch_animation_external_add(Etch *e,
 	Etch_Animation *a;
 	a = etch_animation_new(e, ETCH_EXTERNAL, interpolator, cb, start, stop, repeat, prev, current, data);
 	if (!a) return NULL;
-	e->animations = eina_inlist_append(e->animations, EINA_INLIST_GET(a));
+	etch_animation_append(e, a);
 
 	return a;
 }
@@ -359,5 +730,35 @@ EAPI Etch_Animation * etch_animation_external_add(Etch *e,
  */
 EAPI void etch_animation_remove(Etch *e, Etch_Animation *a)
 {
-	e->animations = eina_inlist_remove(e->animations, EINA_INLIST_GET(a));
+	unsigned int last;
+
+	if (e->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_REMOVE, 0);
+	if (a->dirty)
+	{
+		unsigned int i;
+
+		for (i = 0; i < e->dirty_count; i++)
+		{
+			if (e->dirty[i] != a)
+				continue;
+			e->dirty[i] = e->dirty[--e->dirty_count];
+			break;
+		}
+		a->dirty = EINA_FALSE;
+	}
+	if (a->detached)
+		return;
+	e->layout++;
+	/* keep the state on the animation itself */
+	a->detached = malloc(sizeof(Etch_Animation_State));
+	*a->detached = e->states[a->index];
+	/* move the last state to the hole to keep the array dense */
+	last = --e->count;
+	if (a->index != last)
+	{
+		e->states[a->index] = e->states[last];
+		e->animations[a->index] = e->animations[last];
+		e->animations[a->index]->index = a->index;
+	}
 }
@@ -27,15 +27,11 @@
  * log
  * linear
  * bezier based (1 and 2 control points)
- * - make every interpolator work for every data type, so better a function table
- * - define animatinos based on two properties: PERIODIC, UNIQUE, PERIODIC_MIRROR
  * - the integer return values of the interpolators should be rounded?
  */
 /*============================================================================*
  *                                  Local                                     *
  *============================================================================*/
-typedef double (*Etch_Animation_Interpolator_Calc)(double m, Etch_Interpolator_Type_Data *data);
-
 typedef struct _Etch_Animation_Iterator
 {
 	Eina_Iterator iterator;
@@ -80,47 +76,6 @@ static void _animation_debug(Etch_Animation *a)
 	}
 }
 
-/*----------------------------------------------------------------------------*
- *                               The calc types                               *
- *----------------------------------------------------------------------------*/
-static double _calc_linear(double m, Etch_Interpolator_Type_Data *data)
-{
-	return m;
-}
-
-static double _calc_discrete(double m, Etch_Interpolator_Type_Data *data)
-{
-	return m < 1 ? 0 : 1;
-}
-
-static double _calc_cosin(double m, Etch_Interpolator_Type_Data *data)
-{
-	return (1 - cos(m * M_PI))/2;
-}
-
-static double _calc_quadratic(double m, Etch_Interpolator_Type_Data *data)
-{
-	double t;
-
-        /* FIXME: check if data->q.x0 and data->q.y0 are in [0,1] ? */
-	/* TODO: bench that algo and the one with de casteljau */
-	t = (-data->q.x0 + sqrt(data->q.x0 * data->q.x0 + m * (1 - 2 * data->q.x0))) / (1 - 2 * data->q.x0);
-	return ((1 - 2 * data->q.y0) * t + 2 * data->q.y0) * t;
-}
-
-static double _calc_cubic(double m, Etch_Interpolator_Type_Data *data)
-{
-	/* TODO */
-	return m;
-}
-
-static Etch_Animation_Interpolator_Calc _calcs[ETCH_INTERPOLATOR_TYPES] = {
-	/* ETCH_INTERPOLATOR_DISCRETE 	*/ _calc_discrete,
-	/* ETCH_INTERPOLATOR_LINEAR 	*/ _calc_linear,
-	/* ETCH_INTERPOLATOR_COSIN 	*/ _calc_cosin,
-	/* ETCH_INTERPOLATOR_QUADRATIC 	*/ _calc_quadratic,
-	/* ETCH_INTERPOLATOR_CUBIC 	*/ _calc_cubic,
-};
 /*----------------------------------------------------------------------------*
  *                           The iterator interface                           *
  *----------------------------------------------------------------------------*/
@@ -148,6 +103,7 @@ static void _iterator_free(Etch_Animation_Iterator *it)
 static void _update_start_end(Etch_Animation *a)
 {
 	Etch_Animation_Keyframe *start, *end;
+	Etch_Animation_State *s;
 
 	start = ((Etch_Animation_Keyframe *)a->keys);
 	if (!start)
@@ -156,15 +112,28 @@ static void _update_start_end(Etch_Animation *a)
 	if (!end)
 		return;
 
-	a->start = start->time;
-	a->end = end->time;
+	s = etch_animation_state_get(a);
+	s->start = start->time;
+	s->end = end->time;
 }
 
-static void _keyframe_delete(Etch_Animation_Keyframe *k)
+/* the value of a keyframe has changed, only the segments that start or end
+ * on it change */
+static void _keyframe_changed(Etch_Animation_Keyframe *k)
 {
-	if (k->data && k->data_free)
-		k->data_free(k->data);
-	free(k);
+	Etch_Animation *a = k->animation;
+
+	if (k == a->seg_start || k == a->seg_end)
+		etch_animation_dirty(a);
+}
+
+/* the keyframes have changed in a way that any segment can be affected */
+static void _keyframes_changed(Etch_Animation *a)
+{
+	if (!a->seg_start)
+		return;
+	a->seg_start = a->seg_end = NULL;
+	etch_animation_dirty(a);
 }
 
 static void _keyframes_order(Etch_Animation *a, Etch_Animation_Keyframe *k)
@@ -204,87 +173,401 @@ static void _keyframes_order(Etch_Animation *a, Etch_Animation_Keyframe *k)
 update:
 	_update_start_end(a);
 }
-/*============================================================================*
- *                                 Global                                     *
- *============================================================================*/
-/**
- * To be documented
- * FIXME: To be fixed
- * This functions gets called on etch_process with curr time in an absolute
- * form, isnt better to pass a relative time (i.e relative to the start and end
- * of the animation) ?
+
+/* The simplification refits runs of keyframes into a single segment. The
+ * curves are fitted with the x coordinates of the control points fixed so
+ * x(t) = t, that way the y coordinates are a linear least squares problem.
+ * Only the values of the keyframes are taken into account, not the curves
+ * between them
  */
-void etch_animation_animate(Etch_Animation *a, Etch_Time curr)
+typedef struct _Etch_Simplify_Fit
+{
+	Etch_Interpolator_Type type;
+	Etch_Interpolator_Type_Data idata;
+} Etch_Simplify_Fit;
+
+static Eina_Bool _simplify_value_get(Etch_Animation_Keyframe *k, double *v)
+{
+	switch (k->animation->dtype)
+	{
+		case ETCH_UINT32:
+		*v = k->value.data.u32;
+		return EINA_TRUE;
+
+		case ETCH_INT32:
+		*v = k->value.data.i32;
+		return EINA_TRUE;
+
+		case ETCH_FLOAT:
+		*v = k->value.data.f;
+		return EINA_TRUE;
+
+		case ETCH_DOUBLE:
+		*v = k->value.data.d;
+		return EINA_TRUE;
+
+		default:
+		return EINA_FALSE;
+	}
+}
+
+/* the maximum error of a curve y(m) = m^n + sum(c[i] * b[i](m)) */
+static double _simplify_error(double *t, double *v, int i, int j,
+		int n, double *c)
+{
+	double dt = t[j] - t[i];
+	double dv = v[j] - v[i];
+	double max = 0;
+	int k;
+
+	for (k = i + 1; k < j; k++)
+	{
+		double m = (t[k] - t[i]) / dt;
+		double y;
+		double err;
+
+		switch (n)
+		{
+			case 1:
+			y = m;
+			break;
+
+			case 2:
+			y = m * m + c[0] * 2 * m * (1 - m);
+			break;
+
+			default:
+			y = m * m * m + c[0] * 3 * m * (1 - m) * (1 - m) +
+					c[1] * 3 * m * m * (1 - m);
+			break;
+		}
+		err = fabs(v[i] + dv * y - v[k]);
+		if (err > max)
+			max = err;
+	}
+	return max;
+}
+
+static Eina_Bool _simplify_fit(double *t, double *v, int i, int j,
+		double tolerance, Etch_Simplify_Fit *fit)
+{
+	double dt = t[j] - t[i];
+	double dv = v[j] - v[i];
+	double s00 = 0, s01 = 0, s11 = 0, r0 = 0, r1 = 0;
+	double c[2];
+	double det;
+	int k;
+
+	if (dt <= 0)
+		return EINA_FALSE;
+	if (_simplify_error(t, v, i, j, 1, NULL) <= tolerance)
+	{
+		fit->type = ETCH_INTERPOLATOR_LINEAR;
+		return EINA_TRUE;
+	}
+	/* the curves are scaled by the difference of the values */
+	if (dv == 0)
+		return EINA_FALSE;
+
+	/* quadratic, y = m^2 + y0 * 2m(1 - m) */
+	for (k = i + 1; k < j; k++)
+	{
+		double m = (t[k] - t[i]) / dt;
+		double y = (v[k] - v[i]) / dv;
+		double b0 = 2 * m * (1 - m);
+
+		s00 += b0 * b0;
+		r0 += (y - m * m) * b0;
+	}
+	if (s00 > 0)
+	{
+		c[0] = r0 / s00;
+		if (_simplify_error(t, v, i, j, 2, c) <= tolerance)
+		{
+			fit->type = ETCH_INTERPOLATOR_QUADRATIC;
+			fit->idata.q.x0 = 0.5;
+			fit->idata.q.y0 = c[0];
+			return EINA_TRUE;
+		}
+	}
+
+	/* cubic, y = m^3 + y0 * 3m(1 - m)^2 + y1 * 3m^2(1 - m) */
+	s00 = r0 = 0;
+	for (k = i + 1; k < j; k++)
+	{
+		double m = (t[k] - t[i]) / dt;
+		double y = (v[k] - v[i]) / dv - m * m * m;
+		double b0 = 3 * m * (1 - m) * (1 - m);
+		double b1 = 3 * m * m * (1 - m);
+
+		s00 += b0 * b0;
+		s01 += b0 * b1;
+		s11 += b1 * b1;
+		r0 += y * b0;
+		r1 += y * b1;
+	}
+	det = s00 * s11 - s01 * s01;
+	if (fabs(det) < DBL_EPSILON)
+		return EINA_FALSE;
+	c[0] = (r0 * s11 - r1 * s01) / det;
+	c[1] = (r1 * s00 - r0 * s01) / det;
+	if (_simplify_error(t, v, i, j, 3, c) > tolerance)
+		return EINA_FALSE;
+	fit->type = ETCH_INTERPOLATOR_CUBIC;
+	fit->idata.c.x0 = 1.0 / 3;
+	fit->idata.c.y0 = c[0];
+	fit->idata.c.x1 = 2.0 / 3;
+	fit->idata.c.y1 = c[1];
+	return EINA_TRUE;
+}
+
+/* Find the keyframe times around the evaluated one where the value does
+ * not change, the discrete segments, the ones between equal values, the
+ * steps, and for the strings every segment whose calc only reaches one at
+ * its end. The ticks on those times do not need to evaluate the animation */
+static void _hold_set(Etch_Animation *a, Etch_Animation_State *s,
+		Etch_Animation_Keyframe *start, Etch_Animation_Keyframe *end,
+		double m)
+{
+	Etch_Time length;
+	unsigned int steps, i;
+
+	s->hold_start = s->hold_end = 0;
+	if (m >= 1 || a->dtype == ETCH_EXTERNAL)
+		return;
+	if (a->dtype == ETCH_STRING)
+	{
+		if (start->value.data.string == end->value.data.string)
+			goto segment;
+		switch (start->type)
+		{
+			case ETCH_INTERPOLATOR_DISCRETE:
+			case ETCH_INTERPOLATOR_LINEAR:
+			case ETCH_INTERPOLATOR_COSIN:
+			case ETCH_INTERPOLATOR_STEPS:
+			case ETCH_INTERPOLATOR_SMOOTHSTEP:
+			goto segment;
+
+			default:
+			return;
+		}
+	}
+	/* the kernels return the value as is when both are equal */
+	if (!memcmp(&start->value.data, &end->value.data, etch_data_size(a->dtype)))
+		goto segment;
+	if (start->type == ETCH_INTERPOLATOR_DISCRETE)
+		goto segment;
+	if (start->type != ETCH_INTERPOLATOR_STEPS)
+		return;
+	/* the times of the current step, rounded inwards */
+	steps = start->idata.s.steps ? start->idata.s.steps : 1;
+	i = m * steps;
+	length = end->time - start->time;
+	s->hold_start = start->time + (length * i + steps - 1) / steps;
+	s->hold_end = start->time + (length * (i + 1)) / steps;
+	return;
+segment:
+	s->hold_start = start->time;
+	s->hold_end = end->time;
+}
+
+/* Find the segment of a time of the keyframes and interpolate the value */
+static Etch_Animation_Keyframe * _evaluate(Etch_Animation *a,
+		Etch_Animation_State *s, Etch_Time curr)
 {
 	Eina_Inlist *l;
 	Etch_Animation_Keyframe *start;
 	Etch_Animation_Keyframe *end;
+	double m;
 
+	s->held = EINA_FALSE;
 	/* check that the time is between two keyframes */
+	if (a->track)
+	{
+		if (!etch_track_segment_get(a->track, a->dtype, curr, NULL,
+				&start, &end))
+			return NULL;
+		goto found;
+	}
 	if (!a->keys)
-		return;
+		return NULL;
 
 	/* TODO instead of checking everytime every keyframe we can translate the
 	 * keyframes based on the frame, when a keyframe has passed move it before
 	 * like a circular list */
-	l = (Eina_Inlist *)a->keys;
-	while (l)
+	for (l = (Eina_Inlist *)a->keys; l; l = l->next)
 	{
 		start = (Etch_Animation_Keyframe *)l;
 		end = (Etch_Animation_Keyframe *)(l->next);
 		if (!end)
-			break;
+			return NULL;
 		/* get the keyframe affected */
 		//DBG("-> [%g] %g %g", curr, start->time, end->time);
 		if ((start->time <= curr) && (curr <= end->time))
+			goto found;
+	}
+	return NULL;
+
+found:
+	a->seg_start = start;
+	a->seg_end = end;
+	a->last = curr;
+	/* get the interval between 0 and 1 based on current frame and two keyframes */
+	if (curr == start->time)
+		m = 0;
+	else if (curr == end->time)
+		m = 1;
+	else
+		m = (double)(curr - start->time)/(end->time - start->time);
+	_hold_set(a, s, start, end, m);
+	/* calc the new m and interpolate the value with it */
+	if (a->kernels)
+		m = a->kernels[start->type](start, end, m, &s->curr);
+	else
+	{
+		m = etch_calcs[a->etch->precision][start->type](m, &start->idata);
+		a->interpolator(&(start->value), &(end->value), m, &s->curr, a->data);
+	}
+	s->m = m;
+	return start;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+void etch_animation_keyframe_free(Etch_Animation_Keyframe *k)
+{
+	if (k->value.type == ETCH_STRING)
+		eina_stringshare_del(k->value.data.string);
+	if (k->data && k->data_free)
+		k->data_free(k->data);
+	free(k);
+}
+
+/* Order the whole list of keyframes at once. Used when several keyframe
+ * times have been modified in a batch, the list is usually almost ordered
+ * so an insertion sort is enough
+ */
+void etch_animation_keyframes_sort(Etch_Animation *a)
+{
+	Eina_Inlist *sorted = NULL;
+	Eina_Inlist *l;
+
+	while (a->keys)
+	{
+		Etch_Animation_Keyframe *k = (Etch_Animation_Keyframe *)a->keys;
+		Eina_Inlist *last;
+
+		a->keys = eina_inlist_remove(a->keys, a->keys);
+		/* find the first keyframe greater than k from the end */
+		l = NULL;
+		last = sorted ? sorted->last : NULL;
+		while (last && ((Etch_Animation_Keyframe *)last)->time > k->time)
 		{
-			Etch_Data old;
-			double m;
-			void *data = NULL;
-
-			/* get the interval between 0 and 1 based on current frame and two keyframes */
-			if (curr == start->time)
-				m = 0;
-			else if (curr == end->time)
-				m = 1;
-			else
-				m = (double)(curr - start->time)/(end->time - start->time);
-			/* calc the new m */
-			m = _calcs[start->type](m, &start->idata);
-			/* accelerate the calculations if we get the same m as the previous call */
-			if (m == a->m)
-			{
-				a->cb(start, &a->curr, &a->curr, a->data);
-				return;
-			}
-			/* interpolate the value with the new m */
-			a->interpolator(&(start->value), &(end->value), m, &a->curr, a->data);
-			/* once the value has been set, call the callback */
-			a->cb(start, &a->curr, &a->prev, a->data);
-			/* swap the values */
-			if (a->dtype == ETCH_EXTERNAL)
-			{
-				void *tmp;
-
-				tmp = a->prev.data.external;
-				if (tmp)
-				{
-					a->prev.data.external = a->curr.data.external;
-					a->curr.data.external = tmp;
-				}
-			}
-			else
-			{
-				a->prev = a->curr;
-			}
+			l = last;
+			last = last->prev;
+		}
+		if (!l)
+			sorted = eina_inlist_append(sorted, EINA_INLIST_GET(k));
+		else
+			sorted = eina_inlist_prepend_relative(sorted, EINA_INLIST_GET(k), l);
+	}
+	a->keys = sorted;
+	a->unsorted = EINA_FALSE;
+	_update_start_end(a);
+	_keyframes_changed(a);
+}
 
+/**
+ * To be documented
+ * FIXME: To be fixed
+ * This functions gets called on etch_process with curr time in an absolute
+ * form, isnt better to pass a relative time (i.e relative to the start and end
+ * of the animation) ?
+ */
+void etch_animation_animate(Etch_Animation *a, Etch_Animation_State *s, Etch_Time curr)
+{
+	Etch_Animation_Keyframe *start;
+	Etch_Data old;
+
+	/* lazy animations are evaluated when their value is requested */
+	if (s->lazy)
+	{
+		s->stale = EINA_TRUE;
+		return;
+	}
+	start = _evaluate(a, s, curr);
+	if (!start)
+		return;
+	/* bound animations just store the value, no callback and no previous
+	 * value to keep */
+	if (a->bind)
+	{
+		if (memcmp(a->bind, &s->curr.data, a->bind_size))
+		{
+			memcpy(a->bind, &s->curr.data, a->bind_size);
+			if (a->bind_dirty)
+				a->bind_dirty[a->bind_bit / 32] |= 1U << (a->bind_bit % 32);
+		}
+		return;
+	}
+	/* strings are interned, so a change is just a different
+	 * pointer. The previous value keeps the reference of the
+	 * last reported string */
+	if (a->dtype == ETCH_STRING)
+	{
+		if (s->curr.data.string == s->prev.data.string)
 			return;
+		eina_stringshare_ref(s->curr.data.string);
+		old = s->prev;
+		s->prev = s->curr;
+		if (a->cb) a->cb(start, &s->curr, &old, a->data);
+		eina_stringshare_del(old.data.string);
+		return;
+	}
+	/* once the value has been set, call the callback */
+	if (a->cb) a->cb(start, &s->curr, &s->prev, a->data);
+	/* the callback might have added animations */
+	s = etch_animation_state_get(a);
+	/* swap the values */
+	if (a->dtype == ETCH_EXTERNAL)
+	{
+		void *tmp;
+
+		tmp = s->prev.data.external;
+		if (tmp)
+		{
+			s->prev.data.external = s->curr.data.external;
+			s->curr.data.external = tmp;
 		}
-		l = l->next;
+	}
+	else
+	{
+		s->prev = s->curr;
+	}
+}
+
+/* Evaluate a lazy animation at the time of the Etch it was last processed,
+ * without calling the callback */
+void etch_animation_lazy_evaluate(Etch_Animation *a, Etch_Animation_State *s)
+{
+	Etch_Time t = s->start;
+
+	s->stale = EINA_FALSE;
+	if (s->end - s->start)
+		t = etch_animation_time_map(s, s->processed);
+	if (!_evaluate(a, s, t))
+		return;
+	/* as on etch_animation_animate() the previous value keeps the
+	 * reference of the string given out */
+	if (a->dtype == ETCH_STRING &&
+			s->curr.data.string != s->prev.data.string)
+	{
+		eina_stringshare_ref(s->curr.data.string);
+		eina_stringshare_del(s->prev.data.string);
+		s->prev = s->curr;
 	}
 }
 
-/* TODO add the repeat callback with the an argument of the repeat count */
 Etch_Animation * etch_animation_new(Etch *e,
 		Etch_Data_Type dtype,
 		Etch_Interpolator interpolator,
@@ -297,32 +580,40 @@ Etch_Animation * etch_animation_new(Etch *e,
 		void *data)
 {
 	Etch_Animation *a;
+	Etch_Animation_State *s;
 
 	/* first the checks */
 	if (!interpolator) return NULL;
 
 	a = calloc(1, sizeof(Etch_Animation));
+	/* the state is kept on the animation until it is appended to the
+	 * etch */
+	s = calloc(1, sizeof(Etch_Animation_State));
+	a->detached = s;
 	/* common values */
-	a->m = -1; /* impossible, so the first keyframe will overwrite this */
-	a->start = UINT64_MAX;
+	s->m = -1; /* impossible, so the first keyframe will overwrite this */
+	s->start = UINT64_MAX;
+	s->repeat = 1;
 	a->dtype = dtype;
 	a->interpolator = interpolator;
+	if (dtype != ETCH_EXTERNAL)
+		a->kernels = etch_kernels[e->precision][dtype];
 	a->cb = cb;
 	a->data = data;
-	a->repeat = 1;
 	a->etch = e;
+	a->id = etch_id_new(e);
 	a->start_cb = start;
 	a->stop_cb = stop;
 	a->repeat_cb = repeat;
 	/* in case of external animations we need to keep
 	 * the data
 	 */
-	a->prev.type = dtype;
-	a->curr.type = dtype;
+	s->prev.type = dtype;
+	s->curr.type = dtype;
 	if (dtype == ETCH_EXTERNAL)
 	{
-		a->prev.data.external = prev;
-		a->curr.data.external = curr;
+		s->prev.data.external = prev;
+		s->curr.data.external = curr;
 	}
 
 	return a;
@@ -338,7 +629,37 @@ Etch_Animation * etch_animation_new(Etch *e,
  */
 EAPI void etch_animation_data_get(Etch_Animation *a, Etch_Data *v)
 {
-	if (v) *v = a->curr;
+	Etch_Animation_State *s = etch_animation_state_get(a);
+
+	if (s->stale)
+		etch_animation_lazy_evaluate(a, s);
+	if (v) *v = s->curr;
+}
+/**
+ * Gets the current data value of several animations at once. The lazy
+ * animations that have been processed since their last evaluation are
+ * evaluated
+ * @param a The animations
+ * @param count The number of animations
+ * @param v The array of count values to store the current values
+ */
+EAPI void etch_animation_data_get_array(Etch_Animation **a, unsigned int count,
+		Etch_Data *v)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		etch_animation_data_get(a[i], &v[i]);
+}
+/**
+ * Gets the id of an animation. The id is unique among the animations of the
+ * same Etch, it is kept small and the id of a deleted animation is reused
+ * @param a The Etch_Animation
+ * @return The id
+ */
+EAPI unsigned int etch_animation_id_get(Etch_Animation *a)
+{
+	return a->id;
 }
 /**
  * Deletes an animation
@@ -350,13 +671,32 @@ EAPI void etch_animation_delete(Etch_Animation *a)
 	Eina_Inlist *l2;
 
 	assert(a);
+	if (a->etch->record)
+	{
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_DELETE, 0);
+		/* the removal is part of the deletion */
+		a->record_id = 0;
+	}
 	etch_animation_remove(a->etch, a);
+	if (a->blend)
+		etch_blend_animation_remove(a);
+#ifdef ETCH_HAVE_SHM
+	if (a->export)
+		etch_export_animation_remove(a);
+#endif
+	if (a->track)
+		etch_track_free(a->track);
+	etch_animation_markers_free(a);
 	/* delete the list of keyframes */
 	EINA_INLIST_FOREACH_SAFE(a->keys, l2, k)
 	{
 		a->keys = eina_inlist_remove(a->keys, EINA_INLIST_GET(k));
-		_keyframe_delete(k);
+		etch_animation_keyframe_free(k);
 	}
+	if (a->dtype == ETCH_STRING)
+		eina_stringshare_del(a->detached->prev.data.string);
+	etch_id_free(a->etch, a->id);
+	free(a->detached);
 	free(a);
 }
 
@@ -375,7 +715,94 @@ EAPI Etch_Data_Type etch_animation_data_type_get(Etch_Animation *a)
  */
 EAPI void etch_animation_repeat_set(Etch_Animation *a, int times)
 {
-	a->repeat = times;
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_REPEAT, times);
+	etch_animation_state_get(a)->repeat = times;
+}
+/**
+ * Set the direction of the keyframes on every repeat of an animation. The
+ * keyframes are not modified, only the time they are evaluated at
+ * @param a The Etch_Animation
+ * @param d The direction
+ */
+EAPI void etch_animation_direction_set(Etch_Animation *a, Etch_Animation_Direction d)
+{
+	assert(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_DIRECTION, d);
+	etch_animation_state_get(a)->direction = d;
+}
+/**
+ * Get the direction of the keyframes on every repeat of an animation
+ * @param a The Etch_Animation
+ * @return The direction
+ */
+EAPI Etch_Animation_Direction etch_animation_direction_get(Etch_Animation *a)
+{
+	assert(a);
+	return etch_animation_state_get(a)->direction;
+}
+/**
+ * Set an animation to be lazy. A lazy animation still sends the start, stop
+ * and repeat callbacks and events, but its value is only evaluated when it
+ * is requested with etch_animation_data_get() and kept until the time of
+ * the Etch moves again. Its callback is never called and the bound memory,
+ * if any, is not written. Once it is not lazy anymore it is evaluated again
+ * with the callback. The published values are evaluated on every tick, a
+ * lazy animation published with etch_snapshot_enable() or an export is
+ * evaluated as often as any other
+ * @param a The Etch_Animation
+ * @param lazy EINA_TRUE to evaluate the animation on demand
+ */
+EAPI void etch_animation_lazy_set(Etch_Animation *a, Eina_Bool lazy)
+{
+	Etch_Animation_State *s;
+
+	assert(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_LAZY, lazy);
+	s = etch_animation_state_get(a);
+	if (s->lazy == lazy)
+		return;
+	s->lazy = lazy;
+	if (!lazy && s->stale)
+	{
+		s->stale = EINA_FALSE;
+		etch_animation_dirty(a);
+	}
+}
+/**
+ * Query whenever an animation is lazy
+ * @param a The Etch_Animation
+ * @return EINA_TRUE if the animation is lazy, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_animation_lazy_get(Etch_Animation *a)
+{
+	assert(a);
+	return etch_animation_state_get(a)->lazy;
+}
+/**
+ * Set the priority of an animation. On the ticks with a time budget the
+ * animations of lower priorities are evaluated less often
+ * @param a The Etch_Animation
+ * @param p The priority
+ */
+EAPI void etch_animation_priority_set(Etch_Animation *a, Etch_Priority p)
+{
+	assert(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_PRIORITY, p);
+	etch_animation_state_get(a)->priority = p;
+}
+/**
+ * Get the priority of an animation
+ * @param a The Etch_Animation
+ * @return The priority
+ */
+EAPI Etch_Priority etch_animation_priority_get(Etch_Animation *a)
+{
+	assert(a);
+	return etch_animation_state_get(a)->priority;
 }
 /**
  * Add a new keyframe to the animation
@@ -387,14 +814,22 @@ EAPI Etch_Animation_Keyframe * etch_animation_keyframe_add(Etch_Animation *a)
 	Etch_Animation_Keyframe *k;
 
 	assert(a);
+	if (a->track)
+	{
+		ERR("Can not add keyframes to a compact animation");
+		return NULL;
+	}
 	k = calloc(1, sizeof(Etch_Animation_Keyframe));
 	k->animation = a;
+	k->value.type = a->dtype;
 
 	/* add the new keyframe to the list of keyframes */
 	/* TODO we should always keep the animations ordered */
 	a->keys = eina_inlist_append(a->keys, EINA_INLIST_GET(k));
 	a->unordered = eina_list_append(a->unordered, k);
 	a->count++;
+	if (a->etch->record)
+		etch_record_keyframe_add(k);
 
 	return k;
 }
@@ -407,12 +842,16 @@ EAPI void etch_animation_keyframe_remove(Etch_Animation *a, Etch_Animation_Keyfr
 {
 	assert(a);
 	assert(k);
+	if (a->etch->record)
+		etch_record_keyframe(k, ETCH_RECORD_KEYFRAME_REMOVE, 0);
 	/* remove the keyframe from the list */
 	a->keys = eina_inlist_remove(a->keys, EINA_INLIST_GET(k));
-	a->unordered = eina_list_append(a->unordered, k);
+	a->unordered = eina_list_remove(a->unordered, k);
 	a->count--;
+	if (k == a->seg_start || k == a->seg_end)
+		_keyframes_changed(a);
 	/* TODO recalculate the start and end if necessary */
-	_keyframe_delete(k);
+	etch_animation_keyframe_free(k);
 }
 
 /**
@@ -470,7 +909,9 @@ EAPI Etch * etch_animation_etch_get(Etch_Animation *a)
  */
 EAPI void etch_animation_disable(Etch_Animation *a)
 {
-	a->enabled = EINA_FALSE;
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_DISABLE, 0);
+	etch_animation_state_get(a)->enabled = EINA_FALSE;
 }
 /**
  * Enable an animation
@@ -478,8 +919,11 @@ EAPI void etch_animation_disable(Etch_Animation *a)
  */
 EAPI void etch_animation_enable(Etch_Animation *a)
 {
-	a->enabled = EINA_TRUE;
-	etch_animation_process(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_ENABLE, 0);
+	etch_animation_state_get(a)->enabled = EINA_TRUE;
+	if (!a->detached)
+		etch_animation_process(a->etch, a->index, a->etch->tpf);
 }
 /**
  * Query whenever an animation is atually enabled
@@ -488,7 +932,7 @@ EAPI void etch_animation_enable(Etch_Animation *a)
  */
 EAPI Eina_Bool etch_animation_enabled(Etch_Animation *a)
 {
-	return a->enabled;
+	return etch_animation_state_get(a)->enabled;
 }
 /**
  * Add an offset to an animation. That will increment every animation's keyframe time
@@ -499,8 +943,10 @@ EAPI Eina_Bool etch_animation_enabled(Etch_Animation *a)
 EAPI void etch_animation_offset_add(Etch_Animation *a, Etch_Time inc)
 {
 	assert(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_OFFSET, inc);
 
-	a->offset = inc;
+	etch_animation_state_get(a)->offset = inc;
 }
 /**
  * Set the type of an animation keyframe
@@ -510,7 +956,12 @@ EAPI void etch_animation_offset_add(Etch_Animation *a, Etch_Time inc)
 EAPI void etch_animation_keyframe_type_set(Etch_Animation_Keyframe *k, Etch_Interpolator_Type t)
 {
 	assert(k);
+	if (k->animation->etch->record)
+		etch_record_keyframe(k, ETCH_RECORD_KEYFRAME_TYPE, t);
+	if (k->type == t)
+		return;
 	k->type = t;
+	_keyframe_changed(k);
 }
 /**
  * Get the type of an animation keyframe
@@ -542,6 +993,8 @@ EAPI void etch_animation_keyframe_time_set(Etch_Animation_Keyframe *k, Etch_Time
 	Etch_Animation *a;
 
 	assert(k);
+	if (k->animation->etch->record)
+		etch_record_keyframe(k, ETCH_RECORD_KEYFRAME_TIME, t);
 
 	/* if the time is the same, do nothing */
 	if (k->time == t)
@@ -549,6 +1002,7 @@ EAPI void etch_animation_keyframe_time_set(Etch_Animation_Keyframe *k, Etch_Time
 	a = k->animation;
 	k->time = t;
 	_keyframes_order(a, k);
+	_keyframes_changed(a);
 }
 /**
  * Get the value for a keyfame
@@ -564,16 +1018,31 @@ EAPI void etch_animation_keyframe_value_get(Etch_Animation_Keyframe *k, Etch_Dat
 }
 /**
  * Set the value on a keyframe
+ * In case of an ETCH_STRING animation the string is interned, so the caller
+ * does not need to keep it alive. Every string value Etch gives back is the
+ * interned one and must not be modified or freed.
  * @param k The Etch_Animation_Keyframe
  * @param v The Etch_Data to set the value from
  */
 EAPI void etch_animation_keyframe_value_set(Etch_Animation_Keyframe *k, Etch_Data *v)
 {
+	const char *s;
 
 	assert(k);
 	assert(v);
+	if (k->animation->etch->record)
+		etch_record_keyframe_value(k, v);
 
+	if (k->animation->dtype == ETCH_STRING)
+	{
+		s = k->value.data.string;
+		if (eina_stringshare_replace(&s, v->data.string))
+			_keyframe_changed(k);
+		k->value.data.string = (char *)s;
+		return;
+	}
 	k->value = *v;
+	_keyframe_changed(k);
 }
 /**
  * Sets the control point on a keyframe with a quadratic interpolation type
@@ -582,8 +1051,60 @@ EAPI void etch_animation_keyframe_value_set(Etch_Animation_Keyframe *k, Etch_Dat
  */
 EAPI void etch_animation_keyframe_quadratic_value_set(Etch_Animation_Keyframe *k, double x0, double y0)
 {
+	if (k->animation->etch->record)
+	{
+		double p[] = { x0, y0 };
+
+		etch_record_keyframe_params(k, ETCH_RECORD_KEYFRAME_QUADRATIC, p, 2);
+	}
 	k->idata.q.x0 = x0;
 	k->idata.q.y0 = y0;
+	_keyframe_changed(k);
+}
+/**
+ * Sets the number of steps on a keyframe with a steps interpolation type
+ * @param k The Etch_Animation_Keyframe
+ * @param steps The number of steps
+ */
+EAPI void etch_animation_keyframe_steps_value_set(Etch_Animation_Keyframe *k, unsigned int steps)
+{
+	if (k->animation->etch->record)
+		etch_record_keyframe(k, ETCH_RECORD_KEYFRAME_STEPS, steps);
+	k->idata.s.steps = steps;
+	_keyframe_changed(k);
+}
+/**
+ * Sets the parameters on a keyframe with a spring interpolation type. The
+ * spring has a unit mass and goes from the value of the keyframe to the value
+ * of the next one. The next keyframe is moved to the time the spring settles,
+ * if it is moved afterwards the whole spring is scaled to fit on the new time
+ * @param k The Etch_Animation_Keyframe
+ * @param stiffness The stiffness of the spring
+ * @param damping The damping of the spring, must be greater than zero
+ * @param velocity The initial velocity in distances between both values per
+ * second
+ */
+EAPI void etch_animation_keyframe_spring_value_set(Etch_Animation_Keyframe *k, double stiffness, double damping, double velocity)
+{
+	Etch_Animation_Keyframe *next;
+
+	assert(k);
+	if (k->animation->etch->record)
+	{
+		double p[] = { stiffness, damping, velocity };
+
+		etch_record_keyframe_params(k, ETCH_RECORD_KEYFRAME_SPRING, p, 3);
+	}
+	if (!etch_interpolator_spring_setup(&k->idata.sp, stiffness, damping, velocity))
+	{
+		ERR("Invalid spring, stiffness %g damping %g", stiffness, damping);
+		return;
+	}
+	_keyframe_changed(k);
+	next = (Etch_Animation_Keyframe *)(EINA_INLIST_GET(k)->next);
+	if (next)
+		etch_animation_keyframe_time_set(next,
+				k->time + (Etch_Time)(k->idata.sp.duration * ETCH_SECOND));
 }
 /**
  * Sets the control point on a keyframe with a cubic interpolation type
@@ -593,12 +1114,180 @@ EAPI void etch_animation_keyframe_quadratic_value_set(Etch_Animation_Keyframe *k
  */
 EAPI void etch_animation_keyframe_cubic_value_set(Etch_Animation_Keyframe *k, double x0, double y0, double x1, double y1)
 {
+	if (k->animation->etch->record)
+	{
+		double p[] = { x0, y0, x1, y1 };
+
+		etch_record_keyframe_params(k, ETCH_RECORD_KEYFRAME_CUBIC, p, 4);
+	}
 	k->idata.c.x0 = x0;
 	k->idata.c.y0 = y0;
 	k->idata.c.x1 = x1;
 	k->idata.c.y1 = y1;
+	_keyframe_changed(k);
+}
+
+/**
+ * Reduce the number of keyframes of an animation. Every run of keyframes
+ * that can be replaced by a single linear, quadratic or cubic segment
+ * without moving any removed keyframe value more than the tolerance is
+ * replaced by that segment. The first and last keyframes are always kept.
+ * Only the animations of numeric data types can be simplified
+ * @param a The Etch_Animation
+ * @param tolerance The maximum error allowed, in units of the data type
+ * @return The number of keyframes removed
+ */
+EAPI unsigned int etch_animation_simplify(Etch_Animation *a, double tolerance)
+{
+	Etch_Animation_Keyframe **keys;
+	Etch_Animation_Keyframe *k;
+	Eina_List *l, *l_next;
+	double *t, *v;
+	unsigned int removed = 0;
+	int n = 0;
+	int i;
+
+	assert(a);
+	if (a->etch->record)
+		etch_record_animation_params(a, ETCH_RECORD_ANIMATION_SIMPLIFY, &tolerance, 1);
+	if (a->count < 3 || a->track)
+		return 0;
+	if (a->unsorted)
+		etch_animation_keyframes_sort(a);
+
+	keys = malloc(sizeof(Etch_Animation_Keyframe *) * a->count);
+	t = malloc(sizeof(double) * a->count);
+	v = malloc(sizeof(double) * a->count);
+	EINA_INLIST_FOREACH(a->keys, k)
+	{
+		if (!_simplify_value_get(k, &v[n]))
+			goto end;
+		keys[n] = k;
+		t[n] = k->time;
+		n++;
+	}
+
+	i = 0;
+	while (i < n - 1)
+	{
+		Etch_Simplify_Fit fit;
+		Etch_Simplify_Fit best = { 0 };
+		int ok = i + 1;
+		int fail = n;
+		int j;
+
+		/* grow the segment exponentially while it fits and then
+		 * bisect the last step, this assumes that a segment that
+		 * does not fit will not fit either when it is longer */
+		j = i + 2;
+		while (j < n)
+		{
+			if (!_simplify_fit(t, v, i, j, tolerance, &fit))
+			{
+				fail = j;
+				break;
+			}
+			ok = j;
+			best = fit;
+			j = i + (j - i) * 2;
+		}
+		while (fail - ok > 1)
+		{
+			j = (ok + fail) / 2;
+			if (_simplify_fit(t, v, i, j, tolerance, &fit))
+			{
+				ok = j;
+				best = fit;
+			}
+			else
+				fail = j;
+		}
+		if (ok > i + 1)
+		{
+			keys[i]->type = best.type;
+			keys[i]->idata = best.idata;
+			for (j = i + 1; j < ok; j++)
+			{
+				a->keys = eina_inlist_remove(a->keys, EINA_INLIST_GET(keys[j]));
+				/* mark it to be removed from the unordered list */
+				keys[j]->animation = NULL;
+				removed++;
+			}
+		}
+		i = ok;
+	}
+	if (removed)
+	{
+		EINA_LIST_FOREACH_SAFE(a->unordered, l, l_next, k)
+		{
+			if (!k->animation)
+				a->unordered = eina_list_remove_list(a->unordered, l);
+		}
+		for (i = 0; i < n; i++)
+		{
+			if (keys[i]->animation)
+				continue;
+			etch_animation_keyframe_free(keys[i]);
+			a->count--;
+		}
+		_keyframes_changed(a);
+	}
+end:
+	free(keys);
+	free(t);
+	free(v);
+	return removed;
 }
+/**
+ * Bind an animation to a memory location. Every time the animation is
+ * evaluated the value is stored there in its native type instead of calling
+ * the callback of the animation. Only the numeric and color animations can
+ * be bound
+ * @param a The Etch_Animation
+ * @param dst The memory to store the value to, NULL to unbind and use the
+ * callback again
+ * @param dirty An optional bitmap where the bit is set whenever the stored
+ * value changes, it is never cleared by Etch
+ * @param bit The bit of the bitmap
+ * @return EINA_TRUE if the animation has been bound, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_animation_bind(Etch_Animation *a, void *dst,
+		uint32_t *dirty, unsigned int bit)
+{
+	assert(a);
+	if (a->dtype == ETCH_STRING || a->dtype == ETCH_EXTERNAL)
+		return EINA_FALSE;
+	a->bind = dst;
+	a->bind_size = etch_data_size(a->dtype);
+	a->bind_dirty = dst ? dirty : NULL;
+	a->bind_bit = bit;
+	return EINA_TRUE;
+}
+/**
+ * Bind several animations to the same field of an array of structures.
+ * The animation i is bound to dst + i * stride and to the bit i of the
+ * bitmap
+ * @param a The animations
+ * @param count The number of animations
+ * @param dst The memory of the field of the first structure
+ * @param stride The size of every structure
+ * @param dirty An optional bitmap of at least count bits
+ * @return The number of animations bound
+ */
+EAPI unsigned int etch_animation_bind_array(Etch_Animation **a, unsigned int count,
+		void *dst, size_t stride, uint32_t *dirty)
+{
+	unsigned char *d = dst;
+	unsigned int bound = 0;
+	unsigned int i;
 
+	for (i = 0; i < count; i++, d += stride)
+	{
+		if (etch_animation_bind(a[i], d, dirty, i))
+			bound++;
+	}
+	return bound;
+}
 /**
  *
  */
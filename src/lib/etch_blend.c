@@ -0,0 +1,372 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The animations of the layers are bound to the layers themselves, so the
+ * evaluation only stores their values and marks the layer on the dirty mask
+ * of the blend. Once every animation of the tick has been processed the
+ * dirty blends are accumulated, from the first layer to the last, and the
+ * callback is called if the blended value has changed.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+static unsigned int _components_get(Etch_Data_Type dtype, const Etch_Data *d,
+		double *c)
+{
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		c[0] = d->data.u32;
+		return 1;
+
+		case ETCH_INT32:
+		c[0] = d->data.i32;
+		return 1;
+
+		case ETCH_FLOAT:
+		c[0] = d->data.f;
+		return 1;
+
+		case ETCH_DOUBLE:
+		c[0] = d->data.d;
+		return 1;
+
+		case ETCH_ARGB:
+		c[0] = (d->data.argb >> 24) & 0xff;
+		c[1] = (d->data.argb >> 16) & 0xff;
+		c[2] = (d->data.argb >> 8) & 0xff;
+		c[3] = d->data.argb & 0xff;
+		return 4;
+
+		default:
+		return 0;
+	}
+}
+
+static inline unsigned int _channel(double c)
+{
+	if (c <= 0)
+		return 0;
+	if (c >= 255)
+		return 255;
+	return (unsigned int)(c + 0.5);
+}
+
+static void _components_set(Etch_Data_Type dtype, const double *c, Etch_Data *d)
+{
+	d->type = dtype;
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		d->data.u32 = c[0] <= 0 ? 0 : (uint32_t)(c[0] + 0.5);
+		break;
+
+		case ETCH_INT32:
+		d->data.i32 = (int32_t)lrint(c[0]);
+		break;
+
+		case ETCH_FLOAT:
+		d->data.f = c[0];
+		break;
+
+		case ETCH_DOUBLE:
+		d->data.d = c[0];
+		break;
+
+		case ETCH_ARGB:
+		d->data.argb = (_channel(c[0]) << 24) | (_channel(c[1]) << 16) |
+				(_channel(c[2]) << 8) | _channel(c[3]);
+		break;
+
+		default:
+		break;
+	}
+}
+
+static void _blend(Etch_Blend *b, Etch_Data *res)
+{
+	double acc[4] = { 0, 0, 0, 0 };
+	unsigned int i;
+
+	for (i = 0; i < b->count; i++)
+	{
+		Etch_Blend_Layer *l = &b->layers[i];
+		double v[4];
+		unsigned int n, j;
+
+		if (!l->weight)
+			continue;
+		n = _components_get(b->dtype, &l->value, v);
+		for (j = 0; j < n; j++)
+		{
+			if (l->mode == ETCH_BLEND_ADDITIVE)
+				acc[j] += v[j] * l->weight;
+			else
+				acc[j] += (v[j] - acc[j]) * l->weight;
+		}
+	}
+	_components_set(b->dtype, acc, res);
+}
+
+static Eina_Bool _layer_bind(Etch_Blend *b, Etch_Animation *a, void *dst,
+		unsigned int bit)
+{
+	if (!etch_animation_bind(a, dst, &b->dirty, bit))
+		return EINA_FALSE;
+	a->blend = b;
+	return EINA_TRUE;
+}
+
+static void _layer_unbind(Etch_Animation *a)
+{
+	etch_animation_bind(a, NULL, NULL, 0);
+	a->blend = NULL;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/* Accumulate every blend that has a modified layer */
+void etch_blend_process(Etch *e)
+{
+	unsigned int i;
+
+	for (i = 0; i < e->blends_count; i++)
+	{
+		Etch_Blend *b = e->blends[i];
+		Etch_Data res;
+
+		if (!b->dirty)
+			continue;
+		b->dirty = 0;
+		_blend(b, &res);
+		if (b->has_curr && !memcmp(&res.data, &b->curr.data,
+				etch_data_size(b->dtype)))
+			continue;
+		b->curr = res;
+		b->has_curr = EINA_TRUE;
+		if (b->cb)
+			b->cb(b, &b->curr, b->data);
+	}
+}
+
+/* The animation is going to be deleted, the layers keep its last value */
+void etch_blend_animation_remove(Etch_Animation *a)
+{
+	Etch_Blend *b = a->blend;
+	unsigned int i;
+
+	for (i = 0; i < b->count; i++)
+	{
+		Etch_Blend_Layer *l = &b->layers[i];
+
+		if (l->animation == a)
+			l->animation = NULL;
+		if (l->weight_animation == a)
+			l->weight_animation = NULL;
+	}
+	_layer_unbind(a);
+}
+
+void etch_blend_shutdown(Etch *e)
+{
+	while (e->blends_count)
+		etch_blend_delete(e->blends[0]);
+	free(e->blends);
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Create a new blend
+ * @param e The Etch instance to add the blend to
+ * @param dtype Data type of the layers, only the numeric and color types
+ * can be blended
+ * @param cb Function called whenever the blended value changes
+ * @param data User provided data passed to the callback
+ * @return The new blend or NULL if the data type can not be blended
+ */
+EAPI Etch_Blend * etch_blend_add(Etch *e, Etch_Data_Type dtype,
+		Etch_Blend_Callback cb, void *data)
+{
+	Etch_Blend *b;
+
+	assert(e);
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		case ETCH_INT32:
+		case ETCH_FLOAT:
+		case ETCH_DOUBLE:
+		case ETCH_ARGB:
+		break;
+
+		default:
+		ERR("Data type %d can not be blended", dtype);
+		return NULL;
+	}
+
+	b = calloc(1, sizeof(Etch_Blend));
+	b->etch = e;
+	b->dtype = dtype;
+	b->cb = cb;
+	b->data = data;
+	if (e->blends_count == e->blends_size)
+	{
+		e->blends_size = e->blends_size ? e->blends_size * 2 : 8;
+		e->blends = realloc(e->blends, sizeof(Etch_Blend *) * e->blends_size);
+	}
+	b->index = e->blends_count++;
+	e->blends[b->index] = b;
+	return b;
+}
+/**
+ * Delete a blend. The animations of its layers are unbound and call their
+ * own callbacks again
+ * @param b The blend
+ */
+EAPI void etch_blend_delete(Etch_Blend *b)
+{
+	Etch *e;
+	unsigned int i;
+
+	assert(b);
+	for (i = 0; i < b->count; i++)
+	{
+		Etch_Blend_Layer *l = &b->layers[i];
+
+		if (l->animation)
+			_layer_unbind(l->animation);
+		if (l->weight_animation)
+			_layer_unbind(l->weight_animation);
+	}
+	e = b->etch;
+	if (b->index != --e->blends_count)
+	{
+		e->blends[b->index] = e->blends[e->blends_count];
+		e->blends[b->index]->index = b->index;
+	}
+	free(b);
+}
+/**
+ * Add a layer on top of the layers of a blend. The animation is bound to the
+ * layer, so its callback is no longer called. Until the animation is
+ * evaluated the layer uses its last value
+ * @param b The blend
+ * @param a The animation of the layer, of the same data type as the blend
+ * and not part of another blend
+ * @param mode How the layer is combined with the layers below
+ * @param weight The weight of the layer, usually in [0, 1]
+ * @return The index of the layer or -1 in case of error
+ */
+EAPI int etch_blend_layer_add(Etch_Blend *b, Etch_Animation *a,
+		Etch_Blend_Mode mode, double weight)
+{
+	Etch_Blend_Layer *l;
+
+	assert(b);
+	assert(a);
+	if (b->count == ETCH_BLEND_LAYERS)
+	{
+		ERR("The blend %p already has %d layers", b, ETCH_BLEND_LAYERS);
+		return -1;
+	}
+	if (a->etch != b->etch || a->dtype != b->dtype || a->blend)
+		return -1;
+
+	l = &b->layers[b->count];
+	l->value = etch_animation_state_get(a)->curr;
+	if (!_layer_bind(b, a, &l->value.data, b->count * 2))
+		return -1;
+	l->animation = a;
+	l->weight_animation = NULL;
+	l->mode = mode;
+	l->weight = weight;
+	b->dirty |= 1U << (b->count * 2);
+	return b->count++;
+}
+/**
+ * Set the weight of a layer. If the weight was animated the animation is
+ * unbound
+ * @param b The blend
+ * @param layer The index of the layer
+ * @param weight The weight
+ */
+EAPI void etch_blend_layer_weight_set(Etch_Blend *b, unsigned int layer, double weight)
+{
+	Etch_Blend_Layer *l;
+
+	assert(b);
+	if (layer >= b->count)
+		return;
+	l = &b->layers[layer];
+	if (l->weight_animation)
+	{
+		_layer_unbind(l->weight_animation);
+		l->weight_animation = NULL;
+	}
+	if (l->weight == weight)
+		return;
+	l->weight = weight;
+	b->dirty |= 1U << (layer * 2 + 1);
+}
+/**
+ * Drive the weight of a layer with an animation
+ * @param b The blend
+ * @param layer The index of the layer
+ * @param w The animation of the weight, of ETCH_DOUBLE data type and not
+ * part of another blend
+ * @return EINA_TRUE if the weight is animated, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_blend_layer_weight_animate(Etch_Blend *b, unsigned int layer,
+		Etch_Animation *w)
+{
+	Etch_Blend_Layer *l;
+
+	assert(b);
+	assert(w);
+	if (layer >= b->count)
+		return EINA_FALSE;
+	if (w->etch != b->etch || w->dtype != ETCH_DOUBLE || w->blend)
+		return EINA_FALSE;
+
+	l = &b->layers[layer];
+	if (l->weight_animation)
+		_layer_unbind(l->weight_animation);
+	l->weight = etch_animation_state_get(w)->curr.data.d;
+	_layer_bind(b, w, &l->weight, layer * 2 + 1);
+	l->weight_animation = w;
+	b->dirty |= 1U << (layer * 2 + 1);
+	return EINA_TRUE;
+}
+/**
+ * Get the last blended value
+ * @param b The blend
+ * @param v The location to store the value
+ */
+EAPI void etch_blend_value_get(Etch_Blend *b, Etch_Data *v)
+{
+	assert(b);
+	assert(v);
+	if (b->has_curr)
+		*v = b->curr;
+	else
+		_blend(b, v);
+}
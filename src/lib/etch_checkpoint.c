@@ -0,0 +1,215 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The playback state of the animations already lives on a dense array, so
+ * a checkpoint is a copy of that array followed by the last evaluated time
+ * of every animation. The array is only valid for the same layout of the
+ * states, any animation appended or removed changes the layout generation.
+ * A checkpoint of differences only stores the states that are not equal to
+ * the ones of its base, with their indices.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+static Etch_Checkpoint * _checkpoint_new(Etch *e, const Etch_Checkpoint *base,
+		unsigned int count)
+{
+	Etch_Checkpoint *c;
+	size_t size;
+
+	size = sizeof(Etch_Checkpoint) +
+			count * (sizeof(Etch_Animation_State) + sizeof(Etch_Time));
+	if (base)
+		size += count * sizeof(unsigned int);
+	c = malloc(size);
+	c->base = base;
+	c->layout = e->layout;
+	c->count = count;
+	c->size = size;
+	c->frame = e->frame;
+	c->curr = e->curr;
+	c->events_prev = e->events.prev;
+	c->events_has_prev = e->events.has_prev;
+	c->strings = EINA_FALSE;
+	c->states = (Etch_Animation_State *)(c + 1);
+	c->lasts = (Etch_Time *)(c->states + count);
+	c->indices = base ? (unsigned int *)(c->lasts + count) : NULL;
+	return c;
+}
+
+/* the previous value of a string state holds a reference */
+static void _strings_ref(Etch_Checkpoint *c)
+{
+	unsigned int i;
+
+	for (i = 0; i < c->count; i++)
+	{
+		if (c->states[i].prev.type != ETCH_STRING)
+			continue;
+		eina_stringshare_ref(c->states[i].prev.data.string);
+		c->strings = EINA_TRUE;
+	}
+}
+
+static void _state_restore(Etch *e, unsigned int index,
+		const Etch_Animation_State *s, Etch_Time last)
+{
+	if (s->prev.type == ETCH_STRING)
+	{
+		eina_stringshare_ref(s->prev.data.string);
+		eina_stringshare_del(e->states[index].prev.data.string);
+	}
+	e->states[index] = *s;
+	e->animations[index]->last = last;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Save the playback state of an Etch. The keyframes, the callbacks and the
+ * content of the external values are not part of the checkpoint
+ * @param e The Etch instance
+ * @param base A full checkpoint of the same Etch to only store the
+ * differences from, or NULL to store every state. The base must not be
+ * freed while this checkpoint is in use
+ * @return The new checkpoint
+ */
+EAPI Etch_Checkpoint * etch_checkpoint_save(Etch *e, const Etch_Checkpoint *base)
+{
+	Etch_Checkpoint *c;
+	unsigned int count = 0;
+	unsigned int i;
+
+	assert(e);
+	/* the differences from a base of another layout are all the states */
+	if (base && (base->base || base->layout != e->layout))
+		base = NULL;
+	if (!base)
+	{
+		c = _checkpoint_new(e, NULL, e->count);
+		memcpy(c->states, e->states, sizeof(Etch_Animation_State) * e->count);
+		for (i = 0; i < e->count; i++)
+			c->lasts[i] = e->animations[i]->last;
+		_strings_ref(c);
+		return c;
+	}
+
+	for (i = 0; i < e->count; i++)
+	{
+		if (memcmp(&e->states[i], &base->states[i], sizeof(Etch_Animation_State)) ||
+				e->animations[i]->last != base->lasts[i])
+			count++;
+	}
+	c = _checkpoint_new(e, base, count);
+	for (i = 0, count = 0; i < e->count; i++)
+	{
+		if (!memcmp(&e->states[i], &base->states[i], sizeof(Etch_Animation_State)) &&
+				e->animations[i]->last == base->lasts[i])
+			continue;
+		c->indices[count] = i;
+		c->states[count] = e->states[i];
+		c->lasts[count] = e->animations[i]->last;
+		count++;
+	}
+	_strings_ref(c);
+	return c;
+}
+/**
+ * Restore the playback state of an Etch. No callback is called, the values
+ * restored can be read with etch_animation_data_get()
+ * @param e The Etch instance the checkpoint was saved from
+ * @param c The checkpoint
+ * @return EINA_TRUE if the state has been restored, EINA_FALSE if any
+ * animation has been added or removed since the checkpoint was saved
+ */
+EAPI Eina_Bool etch_checkpoint_restore(Etch *e, const Etch_Checkpoint *c)
+{
+	const Etch_Checkpoint *full = c->base ? c->base : c;
+	unsigned int i;
+
+	assert(e);
+	assert(c);
+	if (c->layout != e->layout || full->layout != e->layout)
+		return EINA_FALSE;
+
+	if (full->strings || c->strings)
+	{
+		for (i = 0; i < full->count; i++)
+			_state_restore(e, i, &full->states[i], full->lasts[i]);
+	}
+	else
+	{
+		memcpy(e->states, full->states, sizeof(Etch_Animation_State) * full->count);
+		for (i = 0; i < full->count; i++)
+			e->animations[i]->last = full->lasts[i];
+	}
+	/* the differences on top of the base */
+	if (c->base)
+	{
+		for (i = 0; i < c->count; i++)
+			_state_restore(e, c->indices[i], &c->states[i], c->lasts[i]);
+	}
+	/* the keyframes might have changed since the checkpoint was saved, the
+	 * segments where the value is held are found again on the next
+	 * evaluation */
+	for (i = 0; i < full->count; i++)
+		e->states[i].hold_start = e->states[i].hold_end = 0;
+	e->frame = c->frame;
+	e->curr = c->curr;
+	e->events.prev = c->events_prev;
+	e->events.has_prev = c->events_has_prev;
+	e->events.count = 0;
+	if (e->snapshot)
+		etch_snapshot_publish(e);
+	return EINA_TRUE;
+}
+/**
+ * Free a checkpoint
+ * @param c The checkpoint
+ */
+EAPI void etch_checkpoint_free(Etch_Checkpoint *c)
+{
+	unsigned int i;
+
+	assert(c);
+	if (c->strings)
+	{
+		for (i = 0; i < c->count; i++)
+		{
+			if (c->states[i].prev.type == ETCH_STRING)
+				eina_stringshare_del(c->states[i].prev.data.string);
+		}
+	}
+	free(c);
+}
+/**
+ * Get the size in bytes of a checkpoint
+ * @param c The checkpoint
+ * @return The size of the checkpoint
+ */
+EAPI size_t etch_checkpoint_size_get(const Etch_Checkpoint *c)
+{
+	assert(c);
+	return c->size;
+}
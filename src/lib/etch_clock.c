@@ -0,0 +1,215 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+/**
+ * The timer is always armed with an absolute deadline computed from the
+ * time the clock was started and the frame number, so the error does not
+ * accumulate between frames.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+struct _Etch_Clock
+{
+	Etch *etch; /** The Etch to tick */
+	int fd; /** The timer file descriptor */
+	Etch_Time base; /** Monotonic time of the frame 0 */
+	unsigned long missed; /** Total number of frames missed */
+	Eina_Bool running;
+	Eina_Bool idle; /** Armed for the next event instead of the next frame */
+};
+
+static Etch_Time _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Etch_Time)ts.tv_sec * ETCH_SECOND + ts.tv_nsec;
+}
+
+static void _arm(Etch_Clock *c)
+{
+	struct itimerspec its;
+	Etch *e = c->etch;
+	Etch_Time next;
+	unsigned long frame;
+
+	memset(&its, 0, sizeof(its));
+	c->idle = EINA_FALSE;
+	frame = e->frame + 1;
+	if (!etch_next_event_get(e, &next))
+	{
+		/* nothing to animate, disarm it */
+		c->idle = EINA_TRUE;
+		timerfd_settime(c->fd, TFD_TIMER_ABSTIME, &its, NULL);
+		return;
+	}
+	/* wake up on the frame of the next event */
+	if (next > e->curr + e->tpf)
+	{
+		frame = (next + e->tpf - 1) / e->tpf;
+		c->idle = EINA_TRUE;
+	}
+	next = c->base + frame * e->tpf;
+	its.it_value.tv_sec = next / ETCH_SECOND;
+	its.it_value.tv_nsec = next % ETCH_SECOND;
+	timerfd_settime(c->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Create a new clock for an Etch
+ * @param e The Etch instance
+ * @return The new clock or NULL in case the timer can not be created
+ */
+EAPI Etch_Clock * etch_clock_new(Etch *e)
+{
+	Etch_Clock *c;
+	int fd;
+
+	assert(e);
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+	{
+		ERR("Can not create the timer (%s)", strerror(errno));
+		return NULL;
+	}
+	c = calloc(1, sizeof(Etch_Clock));
+	c->etch = e;
+	c->fd = fd;
+	return c;
+}
+/**
+ * Delete a clock
+ * @param c The clock
+ */
+EAPI void etch_clock_delete(Etch_Clock *c)
+{
+	assert(c);
+	close(c->fd);
+	free(c);
+}
+/**
+ * Get the file descriptor of a clock. The descriptor becomes readable
+ * whenever the clock needs to be dispatched, add it to the main loop and
+ * call etch_clock_dispatch() then
+ * @param c The clock
+ * @return The file descriptor
+ */
+EAPI int etch_clock_fd_get(Etch_Clock *c)
+{
+	assert(c);
+	return c->fd;
+}
+/**
+ * Start the clock. The current frame of the Etch is taken as the current
+ * time
+ * @param c The clock
+ */
+EAPI void etch_clock_start(Etch_Clock *c)
+{
+	Etch *e;
+
+	assert(c);
+	e = c->etch;
+	c->base = _now() - e->frame * e->tpf;
+	c->running = EINA_TRUE;
+	_arm(c);
+}
+/**
+ * Stop the clock
+ * @param c The clock
+ */
+EAPI void etch_clock_stop(Etch_Clock *c)
+{
+	struct itimerspec its;
+
+	assert(c);
+	memset(&its, 0, sizeof(its));
+	timerfd_settime(c->fd, TFD_TIMER_ABSTIME, &its, NULL);
+	c->running = EINA_FALSE;
+}
+/**
+ * Arm the clock again. When there is nothing to animate the clock only
+ * wakes up for the next event, call this after modifying the animations
+ * of the Etch outside of a dispatch
+ * @param c The clock
+ */
+EAPI void etch_clock_update(Etch_Clock *c)
+{
+	assert(c);
+	if (!c->running)
+		return;
+	_arm(c);
+}
+/**
+ * Dispatch the clock. Moves the Etch to the current frame and arms the
+ * clock again
+ * @param c The clock
+ * @return The number of frames missed on this dispatch
+ */
+EAPI unsigned int etch_clock_dispatch(Etch_Clock *c)
+{
+	Etch *e;
+	uint64_t expirations;
+	unsigned long frame;
+	unsigned int missed = 0;
+
+	assert(c);
+	/* consume the expiration, if there is none this is a spurious wake up */
+	if (read(c->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return 0;
+	if (!c->running)
+		return 0;
+
+	e = c->etch;
+	frame = (_now() - c->base) / e->tpf;
+	if (frame == e->frame + 1)
+		etch_timer_tick(e);
+	else if (frame > e->frame)
+	{
+		if (!c->idle)
+			missed = frame - e->frame - 1;
+		etch_timer_goto(e, frame);
+	}
+	c->missed += missed;
+	_arm(c);
+
+	return missed;
+}
+/**
+ * Get the total number of frames missed since the clock was created
+ * @param c The clock
+ * @return The number of frames
+ */
+EAPI unsigned long etch_clock_missed_get(Etch_Clock *c)
+{
+	assert(c);
+	return c->missed;
+}
@@ -0,0 +1,354 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The queue is the intrusive multiple producer single consumer queue
+ * described by Dmitry Vyukov. Pushing is a single atomic exchange, so
+ * producers never block each other nor the ticking thread.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+typedef enum _Etch_Command_Type
+{
+	ETCH_COMMAND_STUB,
+	ETCH_COMMAND_KEYFRAME_VALUE_SET,
+	ETCH_COMMAND_KEYFRAME_TIME_SET,
+	ETCH_COMMAND_KEYFRAME_TYPE_SET,
+	ETCH_COMMAND_ANIMATION_ENABLE,
+	ETCH_COMMAND_ANIMATION_DISABLE,
+	ETCH_COMMAND_ANIMATION_REMOVE,
+	ETCH_COMMAND_CALL,
+} Etch_Command_Type;
+
+struct _Etch_Command
+{
+	Etch_Command *next;
+	Etch_Command_Type type;
+	union {
+		struct {
+			Etch_Animation_Keyframe *k;
+			Etch_Data value;
+		} value;
+		struct {
+			Etch_Animation_Keyframe *k;
+			Etch_Time t;
+		} time;
+		struct {
+			Etch_Animation_Keyframe *k;
+			Etch_Interpolator_Type t;
+		} type;
+		struct {
+			Etch_Animation *a;
+		} animation;
+		struct {
+			Etch_Command_Callback cb;
+			void *data;
+		} call;
+	} d;
+};
+
+static void _push(Etch_Command_Queue *q, Etch_Command *c)
+{
+	Etch_Command *prev;
+
+	c->next = NULL;
+	prev = ETCH_ATOMIC_XCHG(&q->head, c);
+	/* between the exchange and this store the queue is disconnected,
+	 * the consumer will just see it as empty */
+	ETCH_ATOMIC_STORE(&prev->next, c);
+}
+
+static Etch_Command * _pop(Etch_Command_Queue *q)
+{
+	Etch_Command *tail = q->tail;
+	Etch_Command *next = ETCH_ATOMIC_LOAD(&tail->next);
+	Etch_Command *head;
+
+	if (tail == q->stub)
+	{
+		if (!next)
+			return NULL;
+		q->tail = next;
+		tail = next;
+		next = ETCH_ATOMIC_LOAD(&next->next);
+	}
+	if (next)
+	{
+		q->tail = next;
+		return tail;
+	}
+	head = ETCH_ATOMIC_LOAD(&q->head);
+	/* a producer is in the middle of a push */
+	if (tail != head)
+		return NULL;
+	_push(q, q->stub);
+	next = ETCH_ATOMIC_LOAD(&tail->next);
+	if (next)
+	{
+		q->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+static Etch_Command * _command_new(Etch_Command_Type type)
+{
+	Etch_Command *c;
+
+	c = calloc(1, sizeof(Etch_Command));
+	c->type = type;
+	return c;
+}
+
+static void _command_free(Etch_Command *c)
+{
+	if (c->type == ETCH_COMMAND_KEYFRAME_VALUE_SET &&
+			c->d.value.value.type == ETCH_STRING)
+		free(c->d.value.value.data.string);
+	free(c);
+}
+
+/* apply a single command, return the animation that needs to reorder its
+ * keyframes in case it was not already marked */
+static Etch_Animation * _command_apply(Etch *e, Etch_Command *c)
+{
+	Etch_Animation_Keyframe *k;
+	Etch_Animation *a;
+
+	switch (c->type)
+	{
+		case ETCH_COMMAND_KEYFRAME_VALUE_SET:
+		etch_animation_keyframe_value_set(c->d.value.k, &c->d.value.value);
+		break;
+
+		case ETCH_COMMAND_KEYFRAME_TIME_SET:
+		/* do not order the keyframes here, do it once per animation
+		 * when the whole batch has been applied */
+		k = c->d.time.k;
+		if (e->record)
+			etch_record_keyframe(k, ETCH_RECORD_KEYFRAME_TIME, c->d.time.t);
+		if (k->time == c->d.time.t)
+			break;
+		k->time = c->d.time.t;
+		a = k->animation;
+		if (a->unsorted)
+			break;
+		a->unsorted = EINA_TRUE;
+		return a;
+
+		case ETCH_COMMAND_KEYFRAME_TYPE_SET:
+		etch_animation_keyframe_type_set(c->d.type.k, c->d.type.t);
+		break;
+
+		case ETCH_COMMAND_ANIMATION_ENABLE:
+		/* the process will be done on the tick itself */
+		if (e->record)
+			etch_record_animation(c->d.animation.a,
+					ETCH_RECORD_ANIMATION_ENABLE_DEFERRED, 0);
+		etch_animation_state_get(c->d.animation.a)->enabled = EINA_TRUE;
+		break;
+
+		case ETCH_COMMAND_ANIMATION_DISABLE:
+		etch_animation_disable(c->d.animation.a);
+		break;
+
+		case ETCH_COMMAND_ANIMATION_REMOVE:
+		etch_animation_remove(e, c->d.animation.a);
+		break;
+
+		case ETCH_COMMAND_CALL:
+		c->d.call.cb(e, c->d.call.data);
+		break;
+
+		default:
+		break;
+	}
+	return NULL;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+void etch_command_queue_init(Etch_Command_Queue *q)
+{
+	q->stub = _command_new(ETCH_COMMAND_STUB);
+	q->head = q->stub;
+	q->tail = q->stub;
+}
+
+void etch_command_queue_shutdown(Etch_Command_Queue *q)
+{
+	Etch_Command *c;
+
+	while ((c = _pop(q)))
+		_command_free(c);
+	free(q->stub);
+}
+
+/* Apply every pending command in one batch. Must be called from the thread
+ * that ticks the Etch
+ */
+void etch_command_queue_process(Etch *e)
+{
+	Etch_Command *c;
+	Etch_Animation *a;
+	Eina_List *unsorted = NULL;
+
+	while ((c = _pop(&e->commands)))
+	{
+		a = _command_apply(e, c);
+		if (a) unsorted = eina_list_append(unsorted, a);
+		_command_free(c);
+	}
+	EINA_LIST_FREE(unsorted, a)
+		etch_animation_keyframes_sort(a);
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Post a new value for a keyframe. The value will be set at the beginning
+ * of the next tick
+ * @param k The Etch_Animation_Keyframe
+ * @param v The Etch_Data to set the value from. In case of a string, it is
+ * copied
+ */
+EAPI void etch_command_keyframe_value_set(Etch_Animation_Keyframe *k, Etch_Data *v)
+{
+	Etch_Command *c;
+
+	assert(k);
+	assert(v);
+
+	c = _command_new(ETCH_COMMAND_KEYFRAME_VALUE_SET);
+	c->d.value.k = k;
+	c->d.value.value = *v;
+	c->d.value.value.type = k->animation->dtype;
+	if (c->d.value.value.type == ETCH_STRING && v->data.string)
+		c->d.value.value.data.string = strdup(v->data.string);
+	_push(&k->animation->etch->commands, c);
+}
+/**
+ * Post a new time for a keyframe. The time will be set at the beginning
+ * of the next tick, the keyframes of an animation are ordered only once
+ * no matter how many times were posted
+ * @param k The Etch_Animation_Keyframe
+ * @param t The time to set
+ */
+EAPI void etch_command_keyframe_time_set(Etch_Animation_Keyframe *k, Etch_Time t)
+{
+	Etch_Command *c;
+
+	assert(k);
+
+	c = _command_new(ETCH_COMMAND_KEYFRAME_TIME_SET);
+	c->d.time.k = k;
+	c->d.time.t = t;
+	_push(&k->animation->etch->commands, c);
+}
+/**
+ * Post a new interpolator type for a keyframe
+ * @param k The Etch_Animation_Keyframe
+ * @param t The type of the interpolation
+ */
+EAPI void etch_command_keyframe_type_set(Etch_Animation_Keyframe *k, Etch_Interpolator_Type t)
+{
+	Etch_Command *c;
+
+	assert(k);
+
+	c = _command_new(ETCH_COMMAND_KEYFRAME_TYPE_SET);
+	c->d.type.k = k;
+	c->d.type.t = t;
+	_push(&k->animation->etch->commands, c);
+}
+/**
+ * Post the enabling of an animation
+ * @param a The Etch_Animation
+ */
+EAPI void etch_command_animation_enable(Etch_Animation *a)
+{
+	Etch_Command *c;
+
+	assert(a);
+
+	c = _command_new(ETCH_COMMAND_ANIMATION_ENABLE);
+	c->d.animation.a = a;
+	_push(&a->etch->commands, c);
+}
+/**
+ * Post the disabling of an animation
+ * @param a The Etch_Animation
+ */
+EAPI void etch_command_animation_disable(Etch_Animation *a)
+{
+	Etch_Command *c;
+
+	assert(a);
+
+	c = _command_new(ETCH_COMMAND_ANIMATION_DISABLE);
+	c->d.animation.a = a;
+	_push(&a->etch->commands, c);
+}
+/**
+ * Post the removal of an animation from the Etch instance
+ * @param e The Etch instance to remove the animation from
+ * @param a The animation to remove
+ */
+EAPI void etch_command_animation_remove(Etch *e, Etch_Animation *a)
+{
+	Etch_Command *c;
+
+	assert(e);
+	assert(a);
+
+	c = _command_new(ETCH_COMMAND_ANIMATION_REMOVE);
+	c->d.animation.a = a;
+	_push(&e->commands, c);
+}
+/**
+ * Post a function to be called on the ticking thread. Useful for any
+ * modification that has no specific command, like adding animations
+ * @param e The Etch instance
+ * @param cb The function to call
+ * @param data User provided data passed to the function
+ */
+EAPI void etch_command_call(Etch *e, Etch_Command_Callback cb, void *data)
+{
+	Etch_Command *c;
+
+	assert(e);
+	assert(cb);
+
+	c = _command_new(ETCH_COMMAND_CALL);
+	c->d.call.cb = cb;
+	c->d.call.data = data;
+	_push(&e->commands, c);
+}
+/**
+ * Apply every pending command now instead of waiting for the next tick.
+ * Must be called from the thread that ticks the Etch
+ * @param e The Etch instance
+ */
+EAPI void etch_command_flush(Etch *e)
+{
+	assert(e);
+	etch_command_queue_process(e);
+}
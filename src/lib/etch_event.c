@@ -0,0 +1,276 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The events of a tick are the ones that happen on the range of time
+ * (previous tick, current tick]. They are computed from the start, length
+ * and repeat of every animation, not from the state changes of the
+ * evaluation, so their time is exact no matter the fps. Moving the time
+ * backwards sends no events.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+static void _push(Etch_Event_Queue *q, Etch_Event_Type type,
+		Etch_Animation *a, Etch_Time t, int repeat,
+		Etch_Animation_Marker *m)
+{
+	Etch_Event *ev;
+
+	if (q->count == q->size)
+	{
+		q->size = q->size ? q->size * 2 : 32;
+		q->events = realloc(q->events, sizeof(Etch_Event) * q->size);
+	}
+	ev = &q->events[q->count++];
+	ev->type = type;
+	ev->animation = a;
+	ev->time = t;
+	ev->repeat = repeat;
+	ev->name = m ? m->name : NULL;
+	ev->data = m ? m->data : NULL;
+}
+
+/* the first marker with a time greater than t */
+static unsigned int _marker_find(Etch_Animation *a, Etch_Time t)
+{
+	unsigned int lo = 0, hi = a->markers_count;
+
+	while (lo < hi)
+	{
+		unsigned int mid = (lo + hi) / 2;
+
+		if (a->markers[mid].time <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/* Queue the events of an animation on the range of the current tick */
+void etch_event_queue_collect(Etch *e, unsigned int index)
+{
+	Etch_Event_Queue *q = &e->events;
+	Etch_Animation_State *s = &e->states[index];
+	Etch_Animation *a = e->animations[index];
+	Etch_Time start, length;
+	Etch_Time lo, hi;
+	uint64_t k, kmax;
+
+	if (!s->enabled || !(s->end - s->start))
+		return;
+	hi = e->curr;
+	/* on the first tick only the events at the current time are sent */
+	if (q->has_prev)
+	{
+		if (q->prev >= hi)
+			return;
+		lo = q->prev + 1;
+	}
+	else
+		lo = hi;
+
+	start = s->start + s->offset;
+	length = s->end - s->start;
+	if (hi < start)
+		return;
+	if (lo <= start)
+		_push(q, ETCH_EVENT_START, a, start, 0, NULL);
+
+	/* every repeat that overlaps the range */
+	k = lo <= start ? 0 : (lo - start) / length;
+	kmax = (hi - start) / length;
+	if (s->repeat >= 0 && kmax >= (uint64_t)s->repeat)
+		kmax = s->repeat - 1;
+	for (; s->repeat != 0 && k <= kmax; k++)
+	{
+		Etch_Time base = start + k * length;
+		unsigned int i;
+
+		if (k && lo <= base)
+			_push(q, ETCH_EVENT_REPEAT, a, base, k, NULL);
+		/* the markers of a reversed repeat are crossed from the last one */
+		if (etch_animation_time_position(s, k, 0) != s->start)
+		{
+			for (i = a->markers_count; i; i--)
+			{
+				Etch_Animation_Marker *m = &a->markers[i - 1];
+				Etch_Time t;
+
+				if (m->time > s->end)
+					continue;
+				if (m->time < s->start)
+					break;
+				t = base + (s->end - m->time);
+				if (t < lo)
+					continue;
+				if (t > hi)
+					break;
+				_push(q, ETCH_EVENT_MARKER, a, t, k, m);
+			}
+			continue;
+		}
+		/* the markers of this repeat inside the range */
+		i = lo > base ? _marker_find(a, lo - base - 1 + s->start) : 0;
+		for (; i < a->markers_count; i++)
+		{
+			Etch_Animation_Marker *m = &a->markers[i];
+			Etch_Time t;
+
+			if (m->time < s->start)
+				continue;
+			if (m->time > s->end)
+				break;
+			t = base + (m->time - s->start);
+			if (t > hi)
+				break;
+			_push(q, ETCH_EVENT_MARKER, a, t, k, m);
+		}
+	}
+	/* the end of the last repeat */
+	if (s->repeat > 0)
+	{
+		Etch_Time stop = start + s->repeat * length;
+
+		if (lo <= stop && stop <= hi)
+			_push(q, ETCH_EVENT_STOP, a, stop, s->repeat - 1, NULL);
+	}
+}
+
+/* Order the events of the tick by time, keeping the order of the events of
+ * the same time */
+void etch_event_queue_end(Etch *e)
+{
+	Etch_Event_Queue *q = &e->events;
+	unsigned int i;
+
+	for (i = 1; i < q->count; i++)
+	{
+		Etch_Event ev = q->events[i];
+		unsigned int j = i;
+
+		while (j && q->events[j - 1].time > ev.time)
+		{
+			q->events[j] = q->events[j - 1];
+			j--;
+		}
+		q->events[j] = ev;
+	}
+	q->prev = e->curr;
+	q->has_prev = EINA_TRUE;
+}
+
+void etch_event_queue_shutdown(Etch_Event_Queue *q)
+{
+	free(q->events);
+}
+
+void etch_animation_markers_free(Etch_Animation *a)
+{
+	unsigned int i;
+
+	for (i = 0; i < a->markers_count; i++)
+		eina_stringshare_del(a->markers[i].name);
+	free(a->markers);
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Enable or disable the events. While enabled the start, stop and repeat
+ * callbacks of the animations are not called, the events are queued instead
+ * @param e The Etch instance
+ * @param enable EINA_TRUE to enable the events, EINA_FALSE to disable them
+ */
+EAPI void etch_events_enable(Etch *e, Eina_Bool enable)
+{
+	assert(e);
+	if (e->events.enabled == enable)
+		return;
+	e->events.enabled = enable;
+	e->events.count = 0;
+	e->events.has_prev = EINA_FALSE;
+}
+/**
+ * Get the events of the last tick, ordered by time. They are valid until
+ * the next tick
+ * @param e The Etch instance
+ * @param events The location to store the array of events
+ * @return The number of events
+ */
+EAPI unsigned int etch_events_get(Etch *e, const Etch_Event **events)
+{
+	assert(e);
+	assert(events);
+	*events = e->events.events;
+	return e->events.count;
+}
+/**
+ * Add a marker to an animation. A marker event is sent every time the
+ * animation crosses it, on every repeat
+ * @param a The Etch_Animation
+ * @param t The time of the marker, on the same time as the keyframes
+ * @param name The name of the marker
+ * @param data User provided data of the marker
+ */
+EAPI void etch_animation_marker_add(Etch_Animation *a, Etch_Time t,
+		const char *name, void *data)
+{
+	unsigned int i;
+
+	assert(a);
+	if (a->markers_count == a->markers_size)
+	{
+		a->markers_size = a->markers_size ? a->markers_size * 2 : 4;
+		a->markers = realloc(a->markers,
+				sizeof(Etch_Animation_Marker) * a->markers_size);
+	}
+	i = _marker_find(a, t);
+	memmove(&a->markers[i + 1], &a->markers[i],
+			sizeof(Etch_Animation_Marker) * (a->markers_count - i));
+	a->markers[i].time = t;
+	a->markers[i].name = eina_stringshare_add(name);
+	a->markers[i].data = data;
+	a->markers_count++;
+}
+/**
+ * Remove every marker with a name from an animation
+ * @param a The Etch_Animation
+ * @param name The name of the markers
+ */
+EAPI void etch_animation_marker_remove(Etch_Animation *a, const char *name)
+{
+	unsigned int i, j = 0;
+
+	assert(a);
+	for (i = 0; i < a->markers_count; i++)
+	{
+		if (a->markers[i].name && name && !strcmp(a->markers[i].name, name))
+		{
+			eina_stringshare_del(a->markers[i].name);
+			continue;
+		}
+		a->markers[j++] = a->markers[i];
+	}
+	a->markers_count = j;
+}
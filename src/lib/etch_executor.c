@@ -0,0 +1,424 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Every worker owns a heap of instances ordered by their next deadline and
+ * only locks its own heap. A worker without due instances steals the due
+ * instance of another worker, and as an instance is pushed back to the heap
+ * of the worker that ticked it, the instances migrate from the busy workers
+ * to the idle ones. New instances go to the worker with the lowest load,
+ * measured as the sum of the tick cost of its instances over their period.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+#define IDLE_WAIT (10 * ETCH_MSECOND)
+/* the load of a worker is expressed in parts per million of one core */
+#define LOAD_SCALE 1000000
+
+typedef struct _Etch_Executor_Worker Etch_Executor_Worker;
+
+struct _Etch_Executor_Instance
+{
+	Etch *etch; /** The Etch to tick */
+	Etch_Time period; /** Time between ticks */
+	Etch_Time deadline; /** Absolute time of the next tick */
+	Etch_Time cost; /** Average time a tick takes */
+	unsigned long load; /** Load this instance adds to its worker */
+	unsigned int missed; /** Number of frames missed */
+	int removed; /** Set from any thread when the instance is removed */
+};
+
+struct _Etch_Executor_Worker
+{
+	pthread_t thread;
+	pthread_mutex_t lock; /** Protects the heap */
+	pthread_cond_t cond;
+	Etch_Executor_Instance **heap;
+	unsigned int count;
+	unsigned int size;
+	unsigned long load; /** Sum of the load of its instances */
+	Etch_Executor *executor;
+	unsigned int index;
+};
+
+struct _Etch_Executor
+{
+	Etch_Executor_Worker *workers;
+	unsigned int nworkers;
+	int running;
+	Etch_Executor_Free free_cb;
+	void *data;
+};
+
+static Etch_Time _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Etch_Time)ts.tv_sec * ETCH_SECOND + ts.tv_nsec;
+}
+
+static void _heap_push(Etch_Executor_Worker *w, Etch_Executor_Instance *inst)
+{
+	unsigned int i;
+
+	if (w->count == w->size)
+	{
+		w->size = w->size ? w->size * 2 : 64;
+		w->heap = realloc(w->heap, sizeof(Etch_Executor_Instance *) * w->size);
+	}
+	i = w->count++;
+	while (i)
+	{
+		unsigned int parent = (i - 1) / 2;
+
+		if (w->heap[parent]->deadline <= inst->deadline)
+			break;
+		w->heap[i] = w->heap[parent];
+		i = parent;
+	}
+	w->heap[i] = inst;
+	__atomic_add_fetch(&w->load, inst->load, __ATOMIC_RELAXED);
+}
+
+static Etch_Executor_Instance * _heap_pop(Etch_Executor_Worker *w)
+{
+	Etch_Executor_Instance *top;
+	Etch_Executor_Instance *last;
+	unsigned int i = 0;
+
+	top = w->heap[0];
+	last = w->heap[--w->count];
+	for (;;)
+	{
+		unsigned int child = 2 * i + 1;
+
+		if (child >= w->count)
+			break;
+		if (child + 1 < w->count &&
+				w->heap[child + 1]->deadline < w->heap[child]->deadline)
+			child++;
+		if (last->deadline <= w->heap[child]->deadline)
+			break;
+		w->heap[i] = w->heap[child];
+		i = child;
+	}
+	if (w->count)
+		w->heap[i] = last;
+	__atomic_sub_fetch(&w->load, top->load, __ATOMIC_RELAXED);
+	return top;
+}
+
+/* pop the first instance of the heap only if it is due */
+static Etch_Executor_Instance * _heap_pop_due(Etch_Executor_Worker *w,
+		Etch_Time now, Etch_Time *next)
+{
+	if (!w->count)
+		return NULL;
+	if (w->heap[0]->deadline > now)
+	{
+		if (next && w->heap[0]->deadline < *next)
+			*next = w->heap[0]->deadline;
+		return NULL;
+	}
+	return _heap_pop(w);
+}
+
+static Etch_Executor_Instance * _steal(Etch_Executor_Worker *w, Etch_Time now)
+{
+	Etch_Executor *ex = w->executor;
+	Etch_Executor_Instance *inst = NULL;
+	unsigned int i;
+
+	for (i = 1; i < ex->nworkers && !inst; i++)
+	{
+		Etch_Executor_Worker *victim;
+
+		victim = &ex->workers[(w->index + i) % ex->nworkers];
+		/* never wait for a busy victim, just try the next one */
+		if (pthread_mutex_trylock(&victim->lock))
+			continue;
+		inst = _heap_pop_due(victim, now, NULL);
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return inst;
+}
+
+static void _instance_free(Etch_Executor *ex, Etch_Executor_Instance *inst)
+{
+	if (ex->free_cb) ex->free_cb(inst->etch, ex->data);
+	free(inst);
+}
+
+static void _instance_run(Etch_Executor_Worker *w, Etch_Executor_Instance *inst)
+{
+	Etch_Time start, end;
+
+	if (__atomic_load_n(&inst->removed, __ATOMIC_ACQUIRE))
+	{
+		_instance_free(w->executor, inst);
+		return;
+	}
+
+	start = _now();
+	etch_timer_tick(inst->etch);
+	end = _now();
+
+	/* the fps might have changed on the tick */
+	inst->period = inst->etch->tpf > 0 ? inst->etch->tpf : 1;
+	inst->cost = inst->cost ? (inst->cost * 7 + (end - start)) / 8 : end - start;
+	inst->load = (unsigned long)((inst->cost * LOAD_SCALE) / inst->period);
+	/* keep the deadlines on the same grid to avoid drifting, if we are
+	 * late skip the frames we missed */
+	inst->deadline += inst->period;
+	if (inst->deadline <= end)
+	{
+		Etch_Time late = (end - inst->deadline) / inst->period + 1;
+
+		inst->missed += late;
+		inst->deadline += late * inst->period;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	_heap_push(w, inst);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void * _worker_main(void *data)
+{
+	Etch_Executor_Worker *w = data;
+	Etch_Executor *ex = w->executor;
+
+	while (__atomic_load_n(&ex->running, __ATOMIC_ACQUIRE))
+	{
+		Etch_Executor_Instance *inst;
+		Etch_Time now;
+		Etch_Time next;
+		struct timespec ts;
+
+		now = _now();
+		next = now + IDLE_WAIT;
+		pthread_mutex_lock(&w->lock);
+		inst = _heap_pop_due(w, now, &next);
+		pthread_mutex_unlock(&w->lock);
+		if (!inst)
+			inst = _steal(w, now);
+		if (inst)
+		{
+			_instance_run(w, inst);
+			continue;
+		}
+		/* nothing to do, sleep until our next deadline or until a new
+		 * instance is added */
+		ts.tv_sec = next / ETCH_SECOND;
+		ts.tv_nsec = next % ETCH_SECOND;
+		pthread_mutex_lock(&w->lock);
+		if (__atomic_load_n(&ex->running, __ATOMIC_ACQUIRE) &&
+				(!w->count || w->heap[0]->deadline > now))
+			pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+		pthread_mutex_unlock(&w->lock);
+	}
+	return NULL;
+}
+
+static void _workers_stop(Etch_Executor *ex, unsigned int count)
+{
+	unsigned int i;
+
+	__atomic_store_n(&ex->running, 0, __ATOMIC_RELEASE);
+	for (i = 0; i < count; i++)
+	{
+		Etch_Executor_Worker *w = &ex->workers[i];
+
+		pthread_mutex_lock(&w->lock);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+	}
+}
+
+static void _workers_free(Etch_Executor *ex)
+{
+	unsigned int i;
+
+	for (i = 0; i < ex->nworkers; i++)
+	{
+		Etch_Executor_Worker *w = &ex->workers[i];
+
+		while (w->count)
+			_instance_free(ex, _heap_pop(w));
+		free(w->heap);
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+	}
+	free(ex->workers);
+	free(ex);
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Create a new executor
+ * @param threads Number of threads to use, 0 for one per online processor
+ * @param free Function called when a removed Etch is no longer used by the
+ * executor, it is called from one of the executor threads
+ * @param data User provided data passed to the free function
+ * @return The new executor, NULL if the threads can not be created
+ */
+EAPI Etch_Executor * etch_executor_new(unsigned int threads,
+		Etch_Executor_Free free, void *data)
+{
+	Etch_Executor *ex;
+	pthread_condattr_t attr;
+	unsigned int i;
+
+	if (!threads)
+	{
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = n > 0 ? n : 1;
+	}
+	ex = calloc(1, sizeof(Etch_Executor));
+	ex->workers = calloc(threads, sizeof(Etch_Executor_Worker));
+	ex->nworkers = threads;
+	ex->free_cb = free;
+	ex->data = data;
+	ex->running = 1;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	for (i = 0; i < threads; i++)
+	{
+		Etch_Executor_Worker *w = &ex->workers[i];
+
+		w->executor = ex;
+		w->index = i;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, &attr);
+	}
+	pthread_condattr_destroy(&attr);
+	for (i = 0; i < threads; i++)
+	{
+		Etch_Executor_Worker *w = &ex->workers[i];
+
+		if (pthread_create(&w->thread, NULL, _worker_main, w))
+		{
+			ERR("Can not create the thread %d of the executor", i);
+			_workers_stop(ex, i);
+			_workers_free(ex);
+			return NULL;
+		}
+	}
+	return ex;
+}
+/**
+ * Delete an executor. The threads are stopped and the free function is
+ * called for every Etch that was still on the executor
+ * @param ex The executor
+ */
+EAPI void etch_executor_delete(Etch_Executor *ex)
+{
+	assert(ex);
+	_workers_stop(ex, ex->nworkers);
+	_workers_free(ex);
+}
+/**
+ * Add an Etch to the executor. The Etch will be ticked at its own fps from
+ * one of the executor threads, so from now on it must be only modified
+ * through the command functions. The fps can still be changed from a
+ * command callback, the executor follows it from the next tick. This
+ * function can be called from any thread
+ * @param ex The executor
+ * @param e The Etch instance
+ * @return The handle of the Etch on the executor
+ */
+EAPI Etch_Executor_Instance * etch_executor_add(Etch_Executor *ex, Etch *e)
+{
+	Etch_Executor_Instance *inst;
+	Etch_Executor_Worker *w;
+	unsigned long load = ULONG_MAX;
+	unsigned int i;
+
+	assert(ex);
+	assert(e);
+
+	inst = calloc(1, sizeof(Etch_Executor_Instance));
+	inst->etch = e;
+	inst->period = e->tpf > 0 ? e->tpf : 1;
+	inst->deadline = _now() + inst->period;
+
+	/* the loads are read without locking, it is just a hint */
+	w = &ex->workers[0];
+	for (i = 0; i < ex->nworkers; i++)
+	{
+		unsigned long l;
+
+		l = __atomic_load_n(&ex->workers[i].load, __ATOMIC_RELAXED);
+		if (l < load)
+		{
+			load = l;
+			w = &ex->workers[i];
+		}
+	}
+	pthread_mutex_lock(&w->lock);
+	_heap_push(w, inst);
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	return inst;
+}
+/**
+ * Remove an Etch from the executor. The Etch might still be ticking when
+ * this function returns, the free function passed on the executor creation
+ * will be called once the executor does not use it anymore. The handle is
+ * freed by the executor at any time after this call, so it must not be used
+ * anymore once this function returns. This function can be called from any
+ * thread
+ * @param ex The executor
+ * @param inst The handle returned when the Etch was added
+ */
+EAPI void etch_executor_remove(Etch_Executor *ex, Etch_Executor_Instance *inst)
+{
+	assert(ex);
+	assert(inst);
+	__atomic_store_n(&inst->removed, 1, __ATOMIC_RELEASE);
+}
+/**
+ * Get the statistics of an Etch on the executor. Only meant for monitoring,
+ * the values might be from different ticks
+ * @param inst The handle returned when the Etch was added, it must not have
+ * been removed
+ * @param cost The average time a tick takes
+ * @param missed The number of frames missed because the deadline passed
+ */
+EAPI void etch_executor_instance_stats_get(Etch_Executor_Instance *inst,
+		Etch_Time *cost, unsigned int *missed)
+{
+	assert(inst);
+	if (cost) *cost = inst->cost;
+	if (missed) *missed = inst->missed;
+}
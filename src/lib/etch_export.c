@@ -0,0 +1,407 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+/**
+ * The shared memory region has a fixed layout: a header followed by one
+ * value per slot. It is written by a single process, the one that ticks the
+ * Etch, and protected by a sequence counter that is odd while the values
+ * are being written. The readers copy the values and retry if the counter
+ * was odd or has changed meanwhile, so reading needs no system call and
+ * never blocks the writer. Only the numeric and color values are exported,
+ * pointers have no meaning on another process.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+#define EXPORT_MAGIC 0x45544348 /* ETCH */
+#define EXPORT_VERSION 1
+
+typedef struct _Etch_Export_Value
+{
+	uint32_t type; /** Etch_Data_Type, ETCH_DATATYPES for an empty slot */
+	uint32_t pad;
+	union {
+		uint32_t u32;
+		int32_t i32;
+		float f;
+		double d;
+		uint32_t argb;
+	} data;
+} Etch_Export_Value;
+
+typedef struct _Etch_Export_Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots; /** Number of values after the header */
+	uint32_t seq; /** Odd while the values are being written */
+	uint64_t frame; /** Frame of the values */
+	int64_t time; /** Time of the values */
+	Etch_Export_Value values[];
+} Etch_Export_Header;
+
+struct _Etch_Export
+{
+	Etch *etch;
+	char *name; /** Name of the shared memory object */
+	Etch_Export_Header *header; /** The mapped region */
+	size_t size; /** Size of the mapped region */
+	Etch_Animation **animations; /** Animation of every slot, if any */
+};
+
+struct _Etch_Export_Reader
+{
+	const Etch_Export_Header *header; /** The mapped region */
+	size_t size; /** Size of the mapped region */
+};
+
+static inline size_t _size(unsigned int slots)
+{
+	return sizeof(Etch_Export_Header) + slots * sizeof(Etch_Export_Value);
+}
+
+static void _value_set(Etch_Export_Value *v, const Etch_Data *d)
+{
+	switch (d->type)
+	{
+		case ETCH_UINT32:
+		v->data.u32 = d->data.u32;
+		break;
+
+		case ETCH_INT32:
+		v->data.i32 = d->data.i32;
+		break;
+
+		case ETCH_FLOAT:
+		v->data.f = d->data.f;
+		break;
+
+		case ETCH_DOUBLE:
+		v->data.d = d->data.d;
+		break;
+
+		case ETCH_ARGB:
+		v->data.argb = d->data.argb;
+		break;
+
+		default:
+		v->type = ETCH_DATATYPES;
+		return;
+	}
+	v->type = d->type;
+}
+
+/* Empty a slot, the readers get a value of type ETCH_DATATYPES from now on */
+static void _slot_clear(Etch_Export *ex, unsigned int slot)
+{
+	Etch_Export_Header *h = ex->header;
+
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELAXED);
+	ETCH_ATOMIC_FENCE_RELEASE();
+	h->values[slot].type = ETCH_DATATYPES;
+	ETCH_ATOMIC_STORE(&h->seq, h->seq + 1);
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/* Write the values of the exported animations on the shared memory */
+void etch_export_publish(Etch_Export *ex)
+{
+	Etch_Export_Header *h = ex->header;
+	unsigned int i;
+
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELAXED);
+	ETCH_ATOMIC_FENCE_RELEASE();
+	h->frame = ex->etch->frame;
+	h->time = ex->etch->curr;
+	for (i = 0; i < h->slots; i++)
+	{
+		Etch_Animation *a = ex->animations[i];
+		Etch_Animation_State *s;
+
+		if (!a)
+			continue;
+		s = etch_animation_state_get(a);
+		/* other processes can not evaluate the lazy animations */
+		if (s->stale)
+			etch_animation_lazy_evaluate(a, s);
+		_value_set(&h->values[i], &s->curr);
+	}
+	ETCH_ATOMIC_STORE(&h->seq, h->seq + 1);
+}
+
+/* The animation is going to be deleted or leaves its slot, the slot is
+ * emptied so the readers do not keep its last value */
+void etch_export_animation_remove(Etch_Animation *a)
+{
+	a->export->animations[a->export_slot] = NULL;
+	_slot_clear(a->export, a->export_slot);
+	a->export = NULL;
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Create an exporter of animation values to a POSIX shared memory object.
+ * After every tick the values of the animations assigned to its slots are
+ * published there. Only one exporter can be attached to an Etch
+ * @param e The Etch instance
+ * @param name The name of the shared memory object, like "/etch"
+ * @param slots The number of values to export
+ * @return The new exporter or NULL in case of error
+ */
+EAPI Etch_Export * etch_export_new(Etch *e, const char *name, unsigned int slots)
+{
+	Etch_Export *ex;
+	Etch_Export_Header *h;
+	size_t size;
+	unsigned int i;
+	int fd;
+
+	assert(e);
+	assert(name);
+	if (e->export)
+	{
+		ERR("The Etch %p already has an exporter", e);
+		return NULL;
+	}
+	fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		ERR("Can not open the shared memory %s (%s)", name, strerror(errno));
+		return NULL;
+	}
+	size = _size(slots);
+	if (ftruncate(fd, size) < 0)
+	{
+		ERR("Can not resize the shared memory %s (%s)", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED)
+	{
+		ERR("Can not map the shared memory %s (%s)", name, strerror(errno));
+		shm_unlink(name);
+		return NULL;
+	}
+	h->version = EXPORT_VERSION;
+	h->slots = slots;
+	h->seq = 0;
+	h->frame = e->frame;
+	h->time = e->curr;
+	for (i = 0; i < slots; i++)
+		h->values[i].type = ETCH_DATATYPES;
+	/* the magic goes last, the readers check it before anything else */
+	ETCH_ATOMIC_STORE(&h->magic, EXPORT_MAGIC);
+
+	ex = calloc(1, sizeof(Etch_Export));
+	ex->etch = e;
+	ex->name = strdup(name);
+	ex->header = h;
+	ex->size = size;
+	ex->animations = calloc(slots, sizeof(Etch_Animation *));
+	e->export = ex;
+	return ex;
+}
+/**
+ * Delete an exporter and remove its shared memory object. The readers that
+ * have it mapped keep the last values
+ * @param ex The exporter
+ */
+EAPI void etch_export_delete(Etch_Export *ex)
+{
+	unsigned int i;
+
+	assert(ex);
+	for (i = 0; i < ex->header->slots; i++)
+	{
+		if (ex->animations[i])
+			ex->animations[i]->export = NULL;
+	}
+	munmap(ex->header, ex->size);
+	shm_unlink(ex->name);
+	ex->etch->export = NULL;
+	free(ex->animations);
+	free(ex->name);
+	free(ex);
+}
+/**
+ * Assign an animation to a slot of an exporter. The animation is removed
+ * from its previous slot, if any
+ * @param ex The exporter
+ * @param slot The slot
+ * @param a The animation, of a numeric or color data type, or NULL to
+ * empty the slot. The readers see an emptied slot, or the slot of a deleted
+ * animation, as a value of type ETCH_DATATYPES
+ * @return EINA_TRUE if the slot has been assigned, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_export_animation_set(Etch_Export *ex, unsigned int slot,
+		Etch_Animation *a)
+{
+	assert(ex);
+	if (slot >= ex->header->slots)
+		return EINA_FALSE;
+	if (a && (a->etch != ex->etch || a->dtype == ETCH_STRING ||
+			a->dtype == ETCH_EXTERNAL))
+		return EINA_FALSE;
+	if (ex->animations[slot])
+		etch_export_animation_remove(ex->animations[slot]);
+	if (a)
+	{
+		if (a->export)
+			etch_export_animation_remove(a);
+		a->export = ex;
+		a->export_slot = slot;
+	}
+	ex->animations[slot] = a;
+	return EINA_TRUE;
+}
+/**
+ * Open the values exported by another process
+ * @param name The name of the shared memory object
+ * @return The new reader or NULL in case of error
+ */
+EAPI Etch_Export_Reader * etch_export_reader_new(const char *name)
+{
+	Etch_Export_Reader *r;
+	const Etch_Export_Header *h;
+	struct stat st;
+	int fd;
+
+	assert(name);
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Etch_Export_Header))
+	{
+		close(fd);
+		return NULL;
+	}
+	h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED)
+		return NULL;
+	if (ETCH_ATOMIC_LOAD(&h->magic) != EXPORT_MAGIC ||
+			h->version != EXPORT_VERSION ||
+			_size(h->slots) > (size_t)st.st_size)
+	{
+		munmap((void *)h, st.st_size);
+		return NULL;
+	}
+	r = calloc(1, sizeof(Etch_Export_Reader));
+	r->header = h;
+	r->size = st.st_size;
+	return r;
+}
+/**
+ * Close a reader
+ * @param r The reader
+ */
+EAPI void etch_export_reader_delete(Etch_Export_Reader *r)
+{
+	assert(r);
+	munmap((void *)r->header, r->size);
+	free(r);
+}
+/**
+ * Get the number of slots of a reader
+ * @param r The reader
+ * @return The number of slots
+ */
+EAPI unsigned int etch_export_reader_slots_get(Etch_Export_Reader *r)
+{
+	assert(r);
+	return r->header->slots;
+}
+/**
+ * Read the last published values of a range of slots. All the values
+ * belong to the same tick. This never blocks the exporting process
+ * @param r The reader
+ * @param first The first slot to read
+ * @param count The number of slots to read
+ * @param values The array to store the values to. The empty slots get a
+ * value of type ETCH_DATATYPES
+ * @param frame The frame of the values, can be NULL
+ * @return EINA_TRUE if the values have been read, EINA_FALSE if the range
+ * is out of the slots
+ */
+EAPI Eina_Bool etch_export_reader_read(Etch_Export_Reader *r, unsigned int first,
+		unsigned int count, Etch_Data *values, unsigned long *frame)
+{
+	const Etch_Export_Header *h;
+	uint32_t seq;
+	unsigned int i;
+
+	assert(r);
+	h = r->header;
+	if (first > h->slots || count > h->slots - first)
+		return EINA_FALSE;
+	do
+	{
+		seq = ETCH_ATOMIC_LOAD(&h->seq);
+		if (seq & 1)
+			continue;
+		for (i = 0; i < count; i++)
+		{
+			const Etch_Export_Value *v = &h->values[first + i];
+
+			values[i].type = v->type;
+			values[i].data.d = 0;
+			switch (v->type)
+			{
+				case ETCH_UINT32:
+				values[i].data.u32 = v->data.u32;
+				break;
+
+				case ETCH_INT32:
+				values[i].data.i32 = v->data.i32;
+				break;
+
+				case ETCH_FLOAT:
+				values[i].data.f = v->data.f;
+				break;
+
+				case ETCH_DOUBLE:
+				values[i].data.d = v->data.d;
+				break;
+
+				case ETCH_ARGB:
+				values[i].data.argb = v->data.argb;
+				break;
+
+				default:
+				values[i].type = ETCH_DATATYPES;
+				break;
+			}
+		}
+		if (frame) *frame = h->frame;
+		ETCH_ATOMIC_FENCE_ACQUIRE();
+	} while ((seq & 1) || __atomic_load_n(&h->seq, __ATOMIC_RELAXED) != seq);
+	return EINA_TRUE;
+}
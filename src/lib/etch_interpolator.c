@@ -0,0 +1,552 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * Every data type and every calc type are defined only once, the kernels
+ * for every combination of both are generated from them. That way the
+ * compiler can inline the calc and the interpolation together and the
+ * evaluation of a keyframe is a single function call.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+/*----------------------------------------------------------------------------*
+ *                               The calc types                               *
+ *----------------------------------------------------------------------------*/
+static inline double _calc_linear(double m, Etch_Interpolator_Type_Data *data)
+{
+	return m;
+}
+
+static inline double _calc_discrete(double m, Etch_Interpolator_Type_Data *data)
+{
+	return m < 1 ? 0 : 1;
+}
+
+static inline double _calc_cosin(double m, Etch_Interpolator_Type_Data *data)
+{
+	return (1 - cos(m * M_PI))/2;
+}
+
+static inline double _calc_quadratic(double m, Etch_Interpolator_Type_Data *data)
+{
+	double t;
+
+        /* FIXME: check if data->q.x0 and data->q.y0 are in [0,1] ? */
+	/* TODO: bench that algo and the one with de casteljau */
+	/* with the control point in the middle x(t) = t */
+	if (fabs(1 - 2 * data->q.x0) < DBL_EPSILON)
+		t = m;
+	else
+		t = (-data->q.x0 + sqrt(data->q.x0 * data->q.x0 + m * (1 - 2 * data->q.x0))) / (1 - 2 * data->q.x0);
+	return ((1 - 2 * data->q.y0) * t + 2 * data->q.y0) * t;
+}
+
+/* The cubic bezier goes from (0,0) to (1,1), solve x(t) = m with newton and
+ * fall back to bisection when the derivative is too small */
+static inline double _calc_cubic(double m, Etch_Interpolator_Type_Data *data)
+{
+	double cx, bx, ax, cy, by, ay;
+	double t, lo, hi;
+	int i;
+
+	if (m <= 0) return 0;
+	if (m >= 1) return 1;
+	cx = 3 * data->c.x0;
+	bx = 3 * (data->c.x1 - data->c.x0) - cx;
+	ax = 1 - cx - bx;
+	cy = 3 * data->c.y0;
+	by = 3 * (data->c.y1 - data->c.y0) - cy;
+	ay = 1 - cy - by;
+
+	t = m;
+	for (i = 0; i < 8; i++)
+	{
+		double x = ((ax * t + bx) * t + cx) * t - m;
+		double dx = (3 * ax * t + 2 * bx) * t + cx;
+
+		if (fabs(x) < 1e-7)
+			goto done;
+		if (fabs(dx) < 1e-6)
+			break;
+		t -= x / dx;
+	}
+	lo = 0;
+	hi = 1;
+	t = m;
+	for (i = 0; i < 32; i++)
+	{
+		double x = ((ax * t + bx) * t + cx) * t;
+
+		if (fabs(x - m) < 1e-7)
+			break;
+		if (x < m)
+			lo = t;
+		else
+			hi = t;
+		t = (lo + hi) / 2;
+	}
+done:
+	return ((ay * t + by) * t + cy) * t;
+}
+
+static inline double _calc_expo(double m, Etch_Interpolator_Type_Data *data)
+{
+	if (m <= 0) return 0;
+	if (m >= 1) return 1;
+	if (m < 0.5)
+		return exp2(20 * m - 10) / 2;
+	return (2 - exp2(10 - 20 * m)) / 2;
+}
+
+static inline double _calc_back(double m, Etch_Interpolator_Type_Data *data)
+{
+	const double c1 = 1.70158;
+	const double c3 = c1 + 1;
+	double t = m - 1;
+
+	return 1 + c3 * t * t * t + c1 * t * t;
+}
+
+static inline double _calc_elastic(double m, Etch_Interpolator_Type_Data *data)
+{
+	if (m <= 0) return 0;
+	if (m >= 1) return 1;
+	return exp2(-10 * m) * sin((10 * m - 0.75) * (2 * M_PI / 3)) + 1;
+}
+
+static inline double _calc_bounce(double m, Etch_Interpolator_Type_Data *data)
+{
+	const double n1 = 7.5625;
+	const double d1 = 2.75;
+
+	if (m < 1 / d1)
+		return n1 * m * m;
+	if (m < 2 / d1)
+	{
+		m -= 1.5 / d1;
+		return n1 * m * m + 0.75;
+	}
+	if (m < 2.5 / d1)
+	{
+		m -= 2.25 / d1;
+		return n1 * m * m + 0.9375;
+	}
+	m -= 2.625 / d1;
+	return n1 * m * m + 0.984375;
+}
+
+static inline double _calc_steps(double m, Etch_Interpolator_Type_Data *data)
+{
+	unsigned int steps = data->s.steps ? data->s.steps : 1;
+
+	if (m >= 1) return 1;
+	return floor(m * steps) / steps;
+}
+
+static inline double _calc_smoothstep(double m, Etch_Interpolator_Type_Data *data)
+{
+	return m * m * (3 - 2 * m);
+}
+
+/* The spring is the analytic solution of the damped oscillator
+ * y'' + 2 * zeta * w0 * y' + w0^2 * y = 0 with y(0) = -1 and y'(0) = v0
+ * where y is the distance to the final value. As it only depends on the
+ * time, any time can be evaluated without stepping.
+ * Close to the critical damping the closed forms are the difference of two
+ * big terms that cancel out, so while q = (zeta^2 - 1) * (w0 * t)^2 is
+ * small the solution is evaluated as
+ * exp(-zeta * w0 * t) * (-C(q) + (v0 - zeta * w0) * t * S(q))
+ * where C and S are the series of cosh(sqrt(q)) and sinh(sqrt(q))/sqrt(q),
+ * which are also the ones of cos(sqrt(-q)) and sin(sqrt(-q))/sqrt(-q) for
+ * a negative q. For q = 0 it is the critically damped solution.
+ */
+#define ETCH_SPRING_SERIES 8
+
+static inline void _spring_series(double q, double *c, double *sn)
+{
+	double term = 1;
+	int i;
+
+	*c = *sn = 1;
+	for (i = 1; i < ETCH_SPRING_SERIES; i++)
+	{
+		term *= q / ((2 * i - 1) * (2 * i));
+		*c += term;
+		*sn += term / (2 * i + 1);
+	}
+}
+
+#define ETCH_SPRING(name, exp, cos, sin)				\
+static inline double _spring_##name(Etch_Animation_Spring *s, double t)	\
+{									\
+	double d;							\
+	double q;							\
+									\
+	q = (s->zeta * s->zeta - 1) * s->w0 * s->w0 * t * t;		\
+	if (fabs(q) < 1)						\
+	{								\
+		double c, sn;						\
+									\
+		_spring_series(q, &c, &sn);				\
+		return exp(-s->zeta * s->w0 * t) *			\
+				(-c + (s->v0 - s->zeta * s->w0) * t * sn); \
+	}								\
+	/* underdamped */						\
+	if (s->zeta < 1)						\
+	{								\
+		double wd = s->w0 * sqrt(1 - s->zeta * s->zeta);	\
+		double b = (s->v0 - s->zeta * s->w0) / wd;		\
+									\
+		return exp(-s->zeta * s->w0 * t) *			\
+				(-cos(wd * t) + b * sin(wd * t));	\
+	}								\
+	/* overdamped */						\
+	d = s->w0 * sqrt(s->zeta * s->zeta - 1);			\
+	{								\
+		double r1 = -s->zeta * s->w0 + d;			\
+		double r2 = -s->zeta * s->w0 - d;			\
+		double c2 = (s->v0 + r1) / (r2 - r1);			\
+									\
+		return (-1 - c2) * exp(r1 * t) + c2 * exp(r2 * t);	\
+	}								\
+}
+
+ETCH_SPRING(exact, exp, cos, sin)
+
+static inline double _calc_spring(double m, Etch_Interpolator_Type_Data *data)
+{
+	if (m >= 1) return 1;
+	return 1 + _spring_exact(&data->sp, m * data->sp.duration);
+}
+
+/*----------------------------------------------------------------------------*
+ *                            The fast calc types                             *
+ *----------------------------------------------------------------------------*/
+/* Polynomial approximations of the calc types that use transcendental
+ * functions, without branches. The expo is not approximated, the exp2() of
+ * the math library is already as fast as a polynomial. The maximum absolute
+ * error on [0,1] is below 4e-6, as documented on ETCH_PRECISION_FAST:
+ * cosin 1.8e-6, elastic 3.5e-6 and spring 3.6e-6, the spring relative to
+ * the largest distance to its final value, for any damping
+ */
+
+/* adding this constant rounds a double to the nearest integer, which ends up
+ * on the low bits of the mantissa */
+#define ETCH_ROUND_MAGIC 6755399441055744.0
+
+/* 2^x splitting x in its nearest integer, which goes directly to the
+ * exponent, and the remaining [-0.5,0.5], approximated with a polynomial.
+ * The relative error is below 2.4e-6 */
+static inline double _fast_exp2(double x)
+{
+	union { double d; uint64_t u; } n, v;
+	double f;
+
+	n.d = x + ETCH_ROUND_MAGIC;
+	f = x - (n.d - ETCH_ROUND_MAGIC);
+	v.d = 1.0 + f * (0.6931471805599453 + f * (0.2402265069591007 +
+			f * (0.05550410866482158 + f * (0.009618129107628477 +
+			f * 0.0013333558146428443))));
+	v.u += n.u << 52;
+	return v.d;
+}
+
+/* sin(pi * x) reducing x to [-0.5, 0.5] and using the odd polynomial of
+ * degree 9, the sign is flipped for the odd periods. The absolute error is
+ * below 3.6e-6 */
+static inline double _fast_sinpi(double x)
+{
+	union { double d; uint64_t u; } n, r;
+	double y, y2;
+
+	n.d = x + ETCH_ROUND_MAGIC;
+	y = M_PI * (x - (n.d - ETCH_ROUND_MAGIC));
+	y2 = y * y;
+	r.d = y * (1 + y2 * (-1.0 / 6 + y2 * (1.0 / 120 + y2 * (-1.0 / 5040 +
+			y2 * (1.0 / 362880)))));
+	r.u ^= n.u << 63;
+	return r.d;
+}
+
+static inline double _calc_fast_cosin(double m, Etch_Interpolator_Type_Data *data)
+{
+	return 0.5 + 0.5 * _fast_sinpi(m - 0.5);
+}
+
+/* the clamping to 0 and 1 is done masking the bits of the result */
+static inline double _calc_fast_elastic(double m, Etch_Interpolator_Type_Data *data)
+{
+	union { double d; uint64_t u; } r;
+
+	r.d = _fast_exp2(-10 * m) * _fast_sinpi((10 * m - 0.75) * 2 / 3);
+	r.u &= -(uint64_t)(m < 1);
+	r.d += 1;
+	r.u &= -(uint64_t)(m > 0);
+	return r.d;
+}
+
+static inline double _fast_exp(double x)
+{
+	/* below this the result is a denormal */
+	x = x < -700 ? -700 : x;
+	return _fast_exp2(x * M_LOG2E);
+}
+
+static inline double _fast_cos(double x)
+{
+	return _fast_sinpi(x / M_PI + 0.5);
+}
+
+static inline double _fast_sin(double x)
+{
+	return _fast_sinpi(x / M_PI);
+}
+
+ETCH_SPRING(fast, _fast_exp, _fast_cos, _fast_sin)
+
+static inline double _calc_fast_spring(double m, Etch_Interpolator_Type_Data *data)
+{
+	union { double d; uint64_t u; } r;
+
+	r.d = _spring_fast(&data->sp, m * data->sp.duration);
+	r.u &= -(uint64_t)(m < 1);
+	return 1 + r.d;
+}
+
+/*----------------------------------------------------------------------------*
+ *                               The data types                               *
+ *----------------------------------------------------------------------------*/
+/* we only handle the discrete version, the strings are already interned
+ * so this is just a pointer swap */
+static inline void _interpolate_string(char *a, char *b, double m, char **r)
+{
+	*r = m < 1 ? a : b;
+}
+
+/* the interpolator of a data type */
+#define ETCH_INTERPOLATOR(name, type, field, interpolate)		\
+void etch_interpolator_##name(Etch_Data *da, Etch_Data *db, double m,	\
+		Etch_Data *res, void *data)				\
+{									\
+	type a;								\
+	type b;								\
+									\
+	a = da->data.field;						\
+	b = db->data.field;						\
+	/* handle specific case where a and b are equal (constant) */	\
+	if (a == b)							\
+	{								\
+		res->data.field = a;					\
+		return;							\
+	}								\
+	interpolate(a, b, m, &(res->data.field));			\
+}
+
+/* the kernel of a data type and a calc type */
+#define ETCH_KERNEL(name, type, field, interpolate, calc)		\
+static double _kernel_##name##_##calc(Etch_Animation_Keyframe *start,	\
+		Etch_Animation_Keyframe *end, double m, Etch_Data *res)	\
+{									\
+	type a;								\
+	type b;								\
+									\
+	a = start->value.data.field;					\
+	b = end->value.data.field;					\
+	m = _calc_##calc(m, &start->idata);				\
+	if (a == b)							\
+	{								\
+		res->data.field = a;					\
+		return m;						\
+	}								\
+	interpolate(a, b, m, &(res->data.field));			\
+	return m;							\
+}
+
+/* every kernel of a data type */
+#define ETCH_KERNELS(name, type, field, interpolate)			\
+	ETCH_KERNEL(name, type, field, interpolate, discrete)		\
+	ETCH_KERNEL(name, type, field, interpolate, linear)		\
+	ETCH_KERNEL(name, type, field, interpolate, cosin)		\
+	ETCH_KERNEL(name, type, field, interpolate, quadratic)		\
+	ETCH_KERNEL(name, type, field, interpolate, cubic)		\
+	ETCH_KERNEL(name, type, field, interpolate, expo)		\
+	ETCH_KERNEL(name, type, field, interpolate, back)		\
+	ETCH_KERNEL(name, type, field, interpolate, elastic)		\
+	ETCH_KERNEL(name, type, field, interpolate, bounce)		\
+	ETCH_KERNEL(name, type, field, interpolate, steps)		\
+	ETCH_KERNEL(name, type, field, interpolate, smoothstep)		\
+	ETCH_KERNEL(name, type, field, interpolate, spring)		\
+	ETCH_KERNEL(name, type, field, interpolate, fast_cosin)		\
+	ETCH_KERNEL(name, type, field, interpolate, fast_elastic)	\
+	ETCH_KERNEL(name, type, field, interpolate, fast_spring)
+
+/* the table of kernels of a data type, indexed by the calc type */
+#define ETCH_KERNELS_TABLE(name, prefix) {				\
+	[ETCH_INTERPOLATOR_DISCRETE] = _kernel_##name##_discrete,	\
+	[ETCH_INTERPOLATOR_LINEAR] = _kernel_##name##_linear,		\
+	[ETCH_INTERPOLATOR_COSIN] = _kernel_##name##_##prefix##cosin,	\
+	[ETCH_INTERPOLATOR_QUADRATIC] = _kernel_##name##_quadratic,	\
+	[ETCH_INTERPOLATOR_CUBIC] = _kernel_##name##_cubic,		\
+	[ETCH_INTERPOLATOR_EXPO] = _kernel_##name##_expo,		\
+	[ETCH_INTERPOLATOR_BACK] = _kernel_##name##_back,		\
+	[ETCH_INTERPOLATOR_ELASTIC] = _kernel_##name##_##prefix##elastic, \
+	[ETCH_INTERPOLATOR_BOUNCE] = _kernel_##name##_bounce,		\
+	[ETCH_INTERPOLATOR_STEPS] = _kernel_##name##_steps,		\
+	[ETCH_INTERPOLATOR_SMOOTHSTEP] = _kernel_##name##_smoothstep,	\
+	[ETCH_INTERPOLATOR_SPRING] = _kernel_##name##_##prefix##spring,	\
+}
+
+#define ETCH_DATA_TYPE(name, type, field, interpolate)			\
+	ETCH_INTERPOLATOR(name, type, field, interpolate)		\
+	ETCH_KERNELS(name, type, field, interpolate)
+
+ETCH_DATA_TYPE(uint32, uint32_t, u32, etch_interpolate_uint32)
+ETCH_DATA_TYPE(int32, int32_t, i32, etch_interpolate_int32)
+ETCH_DATA_TYPE(float, float, f, etch_interpolate_float)
+ETCH_DATA_TYPE(double, double, d, etch_interpolate_double)
+ETCH_DATA_TYPE(argb, uint32_t, argb, etch_interpolate_argb)
+ETCH_DATA_TYPE(string, char *, string, _interpolate_string)
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/* Compute the parameters of a spring of unit mass. The duration is the time
+ * it takes the spring to stay closer than ETCH_SPRING_EPSILON to the final
+ * value, found over the envelope of the oscillation, which is decreasing
+ * once it has reached its maximum
+ */
+#define ETCH_SPRING_EPSILON 1e-3
+
+static double _spring_envelope(Etch_Animation_Spring *s, double t)
+{
+	double q;
+
+	/* cosh and sinh bound cos and sin */
+	q = (s->zeta * s->zeta - 1) * s->w0 * s->w0 * t * t;
+	if (fabs(q) < 1)
+	{
+		double c, sn;
+
+		_spring_series(fabs(q), &c, &sn);
+		return exp(-s->zeta * s->w0 * t) *
+				(c + fabs(s->v0 - s->zeta * s->w0) * t * sn);
+	}
+	if (s->zeta < 1)
+	{
+		double wd = s->w0 * sqrt(1 - s->zeta * s->zeta);
+		double b = (s->v0 - s->zeta * s->w0) / wd;
+
+		return exp(-s->zeta * s->w0 * t) * sqrt(1 + b * b);
+	}
+	{
+		double d = s->w0 * sqrt(s->zeta * s->zeta - 1);
+		double r1 = -s->zeta * s->w0 + d;
+		double r2 = -s->zeta * s->w0 - d;
+		double c2 = (s->v0 + r1) / (r2 - r1);
+
+		return fabs(-1 - c2) * exp(r1 * t) + fabs(c2) * exp(r2 * t);
+	}
+}
+
+Eina_Bool etch_interpolator_spring_setup(Etch_Animation_Spring *s,
+		double stiffness, double damping, double velocity)
+{
+	double lo = 0, hi;
+	int i;
+
+	/* without damping the spring never settles */
+	if (stiffness <= 0 || damping <= 0)
+		return EINA_FALSE;
+	s->w0 = sqrt(stiffness);
+	s->zeta = damping / (2 * s->w0);
+	s->v0 = velocity;
+	/* the slowest decay rate gives a first guess */
+	if (s->zeta < 1)
+		hi = 1 / (s->zeta * s->w0);
+	else
+		hi = 1 / (s->w0 * (s->zeta - sqrt(s->zeta * s->zeta - 1)));
+	while (_spring_envelope(s, hi) > ETCH_SPRING_EPSILON)
+	{
+		lo = hi;
+		hi *= 2;
+	}
+	for (i = 0; i < 32; i++)
+	{
+		double mid = (lo + hi) / 2;
+
+		if (_spring_envelope(s, mid) > ETCH_SPRING_EPSILON)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	s->duration = hi;
+	return EINA_TRUE;
+}
+Etch_Animation_Interpolator_Calc etch_calcs[ETCH_PRECISIONS][ETCH_INTERPOLATOR_TYPES] = {
+	[ETCH_PRECISION_EXACT] = {
+		/* ETCH_INTERPOLATOR_DISCRETE 	*/ _calc_discrete,
+		/* ETCH_INTERPOLATOR_LINEAR 	*/ _calc_linear,
+		/* ETCH_INTERPOLATOR_COSIN 	*/ _calc_cosin,
+		/* ETCH_INTERPOLATOR_QUADRATIC 	*/ _calc_quadratic,
+		/* ETCH_INTERPOLATOR_CUBIC 	*/ _calc_cubic,
+		/* ETCH_INTERPOLATOR_EXPO 	*/ _calc_expo,
+		/* ETCH_INTERPOLATOR_BACK 	*/ _calc_back,
+		/* ETCH_INTERPOLATOR_ELASTIC 	*/ _calc_elastic,
+		/* ETCH_INTERPOLATOR_BOUNCE 	*/ _calc_bounce,
+		/* ETCH_INTERPOLATOR_STEPS 	*/ _calc_steps,
+		/* ETCH_INTERPOLATOR_SMOOTHSTEP */ _calc_smoothstep,
+		/* ETCH_INTERPOLATOR_SPRING 	*/ _calc_spring,
+	},
+	[ETCH_PRECISION_FAST] = {
+		/* ETCH_INTERPOLATOR_DISCRETE 	*/ _calc_discrete,
+		/* ETCH_INTERPOLATOR_LINEAR 	*/ _calc_linear,
+		/* ETCH_INTERPOLATOR_COSIN 	*/ _calc_fast_cosin,
+		/* ETCH_INTERPOLATOR_QUADRATIC 	*/ _calc_quadratic,
+		/* ETCH_INTERPOLATOR_CUBIC 	*/ _calc_cubic,
+		/* ETCH_INTERPOLATOR_EXPO 	*/ _calc_expo,
+		/* ETCH_INTERPOLATOR_BACK 	*/ _calc_back,
+		/* ETCH_INTERPOLATOR_ELASTIC 	*/ _calc_fast_elastic,
+		/* ETCH_INTERPOLATOR_BOUNCE 	*/ _calc_bounce,
+		/* ETCH_INTERPOLATOR_STEPS 	*/ _calc_steps,
+		/* ETCH_INTERPOLATOR_SMOOTHSTEP */ _calc_smoothstep,
+		/* ETCH_INTERPOLATOR_SPRING 	*/ _calc_fast_spring,
+	},
+};
+
+/* the external data type has no kernels, the calc and the user provided
+ * interpolator are called instead */
+Etch_Kernel etch_kernels[ETCH_PRECISIONS][ETCH_DATATYPES][ETCH_INTERPOLATOR_TYPES] = {
+	[ETCH_PRECISION_EXACT] = {
+		[ETCH_UINT32] = ETCH_KERNELS_TABLE(uint32, ),
+		[ETCH_INT32] = ETCH_KERNELS_TABLE(int32, ),
+		[ETCH_FLOAT] = ETCH_KERNELS_TABLE(float, ),
+		[ETCH_DOUBLE] = ETCH_KERNELS_TABLE(double, ),
+		[ETCH_ARGB] = ETCH_KERNELS_TABLE(argb, ),
+		[ETCH_STRING] = ETCH_KERNELS_TABLE(string, ),
+	},
+	[ETCH_PRECISION_FAST] = {
+		[ETCH_UINT32] = ETCH_KERNELS_TABLE(uint32, fast_),
+		[ETCH_INT32] = ETCH_KERNELS_TABLE(int32, fast_),
+		[ETCH_FLOAT] = ETCH_KERNELS_TABLE(float, fast_),
+		[ETCH_DOUBLE] = ETCH_KERNELS_TABLE(double, fast_),
+		[ETCH_ARGB] = ETCH_KERNELS_TABLE(argb, fast_),
+		[ETCH_STRING] = ETCH_KERNELS_TABLE(string, fast_),
+	},
+};
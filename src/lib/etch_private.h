@@ -50,16 +50,210 @@
 
 extern int etch_log_dom_global;
 
+/* atomic helpers used by the lock free structures */
+#define ETCH_ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ETCH_ATOMIC_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define ETCH_ATOMIC_XCHG(p, v) __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+#define ETCH_ATOMIC_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define ETCH_ATOMIC_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+typedef struct _Etch_Command Etch_Command;
+
+/**
+ * Multiple producer, single consumer queue of commands. Any thread can
+ * push, only the thread that ticks the Etch pops
+ */
+typedef struct _Etch_Command_Queue
+{
+	Etch_Command *head; /** Last pushed command, written by the producers */
+	Etch_Command *tail; /** Next command to pop, only used by the consumer */
+	Etch_Command *stub; /** Dummy node to keep the queue never empty */
+} Etch_Command_Queue;
+
+/**
+ * Events of the animations found on the last tick, filled and read only by
+ * the thread that ticks the Etch
+ */
+typedef struct _Etch_Event_Queue
+{
+	Etch_Event *events; /** Events of the last tick, ordered by time */
+	unsigned int count;
+	unsigned int size;
+	Etch_Time prev; /** Time of the previous tick */
+	Eina_Bool has_prev; /** There was a previous tick */
+	Eina_Bool enabled;
+} Etch_Event_Queue;
+
+typedef struct _Etch_Animation_Marker
+{
+	Etch_Time time; /** Time on the keyframes of the animation */
+	const char *name;
+	void *data;
+} Etch_Animation_Marker;
+
+#define ETCH_BLEND_LAYERS 16
+
+typedef struct _Etch_Blend_Layer
+{
+	Etch_Animation *animation; /** animation of the value, NULL once deleted */
+	Etch_Animation *weight_animation; /** animation of the weight, if any */
+	Etch_Blend_Mode mode;
+	Etch_Data value; /** last value of the animation, bound to it */
+	double weight; /** bound to the weight animation, if any */
+} Etch_Blend_Layer;
+
+struct _Etch_Blend
+{
+	Etch *etch;
+	unsigned int index; /** index on the blends of the Etch */
+	Etch_Data_Type dtype;
+	Etch_Blend_Callback cb;
+	void *data;
+	Etch_Blend_Layer layers[ETCH_BLEND_LAYERS]; /** fixed, the animations are bound to them */
+	unsigned int count;
+	uint32_t dirty; /** bit 2i for the value of the layer i, 2i + 1 for its weight */
+	Etch_Data curr; /** last blended value */
+	Eina_Bool has_curr;
+};
+
+/**
+ * Operations of a record log
+ */
+typedef enum _Etch_Record_Op
+{
+	ETCH_RECORD_TIMER_FPS,
+	ETCH_RECORD_TIMER_TICK,
+	ETCH_RECORD_TIMER_TICK_BUDGET,
+	ETCH_RECORD_TIMER_SET,
+	ETCH_RECORD_TIMER_GOTO,
+	ETCH_RECORD_FLUSH,
+	ETCH_RECORD_PRECISION,
+	ETCH_RECORD_ANIMATION_ADD,
+	ETCH_RECORD_ANIMATION_DELETE,
+	ETCH_RECORD_ANIMATION_REMOVE,
+	ETCH_RECORD_ANIMATION_ENABLE,
+	ETCH_RECORD_ANIMATION_ENABLE_DEFERRED, /** enabled by a command */
+	ETCH_RECORD_ANIMATION_DISABLE,
+	ETCH_RECORD_ANIMATION_REPEAT,
+	ETCH_RECORD_ANIMATION_OFFSET,
+	ETCH_RECORD_ANIMATION_DIRECTION,
+	ETCH_RECORD_ANIMATION_PRIORITY,
+	ETCH_RECORD_ANIMATION_LAZY,
+	ETCH_RECORD_ANIMATION_SIMPLIFY,
+	ETCH_RECORD_ANIMATION_COMPACT,
+	ETCH_RECORD_KEYFRAME_ADD,
+	ETCH_RECORD_KEYFRAME_REMOVE,
+	ETCH_RECORD_KEYFRAME_TYPE,
+	ETCH_RECORD_KEYFRAME_TIME,
+	ETCH_RECORD_KEYFRAME_VALUE,
+	ETCH_RECORD_KEYFRAME_QUADRATIC,
+	ETCH_RECORD_KEYFRAME_CUBIC,
+	ETCH_RECORD_KEYFRAME_STEPS,
+	ETCH_RECORD_KEYFRAME_SPRING,
+	ETCH_RECORD_OPS
+} Etch_Record_Op;
+
+typedef struct _Etch_Record Etch_Record;
+
+/**
+ * The playback state of an animation, that is, everything the tick needs
+ * to read. The states of every animation of an Etch are kept together on
+ * a dense array so the tick goes linearly through memory.
+ */
+typedef struct _Etch_Animation_State
+{
+	/* TODO if the marks are already ordered do we need to have the start
+	 * and end time duplicated here? */
+	Etch_Time start; /** initial time */
+	Etch_Time end; /** end time already */
+	Etch_Time offset; /*  the real offset */
+	int repeat; /** number of times the animation will repeat, -1 for infinite */
+	Etch_Animation_Direction direction; /** direction of every repeat */
+	Etch_Priority priority; /** priority when the ticks have a budget */
+	Etch_Time processed; /** time of the Etch when it was last processed */
+	Etch_Time hold_start; /** keyframe times where the value does not change */
+	Etch_Time hold_end; /** until this one, excluded */
+	Eina_Bool lazy; /** only evaluated when the value is requested */
+	Eina_Bool stale; /** lazy and processed since the last evaluation */
+	Eina_Bool held; /** the last process did not need to evaluate */
+	Eina_Bool enabled;/** easy way to disable/enable an animation */
+	Eina_Bool started;
+	/* TODO make m a fixed point var of type 1.31 */
+	double m; /** last interpolator value in the range [0,1] */
+	Etch_Data curr; /** current value in the whole animation */
+	Etch_Data prev; /** previous value in the whole animation */
+} Etch_Animation_State;
+
+struct _Etch_Checkpoint
+{
+	const Etch_Checkpoint *base; /** checkpoint the differences are from, if any */
+	unsigned int layout; /** generation of the layout of the states */
+	unsigned int count; /** number of states stored */
+	size_t size; /** size of the whole blob */
+	unsigned long frame;
+	Etch_Time curr;
+	Etch_Time events_prev;
+	Eina_Bool events_has_prev;
+	Eina_Bool strings; /** some state holds a string reference */
+	Etch_Animation_State *states; /** the states, after the header */
+	Etch_Time *lasts; /** last evaluated time of every stored state */
+	unsigned int *indices; /** index of every stored state, for differences */
+};
+
+/**
+ * One of the buffers of the snapshot, protected by a sequence counter
+ */
+typedef struct _Etch_Snapshot_Buffer
+{
+	unsigned int seq; /** Odd while the buffer is being written */
+	unsigned long frame; /** Frame of the values */
+	Etch_Time time; /** Time of the values */
+	Etch_Data *values; /** Values indexed by the animation id */
+} Etch_Snapshot_Buffer;
+
+/**
+ * Double buffered copy of the animation values published at the end of
+ * every tick
+ */
+typedef struct _Etch_Snapshot
+{
+	Etch_Snapshot_Buffer buffers[2];
+	unsigned int generation; /** Number of published buffers */
+	unsigned int size; /** Number of values on each buffer */
+} Etch_Snapshot;
+
 /**
  *
  */
 struct _Etch
 {
-	Eina_Inlist *animations; /** List of objects */
+	Etch_Animation_State *states; /** State of every animation */
+	Etch_Animation **animations; /** Animation of every state */
+	unsigned int count; /** Number of animations */
+	unsigned int size; /** Allocated number of animations */
+	unsigned int layout; /** Generation of the layout of the states */
+	Etch_Command_Queue commands; /** Pending commands from other threads */
+	Etch_Event_Queue events; /** Events sent on the last tick */
+	Etch_Snapshot *snapshot; /** Values published for other threads */
+	Etch_Export *export; /** Values published for other processes */
+	Etch_Record *record; /** Log of the calls, if recording */
+	unsigned int ids; /** Next animation id never used */
+	unsigned int *free_ids; /** Ids of deleted animations to reuse */
+	unsigned int free_ids_count;
+	unsigned int free_ids_size;
+	Etch_Animation **dirty; /** Animations modified since their evaluation */
+	unsigned int dirty_count;
+	unsigned int dirty_size;
+	Etch_Blend **blends; /** Blends of the animations */
+	unsigned int blends_count;
+	unsigned int blends_size;
 	unsigned long frame; /** Current frame */
 	unsigned int fps; /** Number of frames per second */
 	Etch_Time tpf; /** Time per frame */
 	Etch_Time curr; /** Current time in seconds */
+	Etch_Precision precision; /** Precision of the interpolators */
+	Etch_Time eval_cost; /** Average time an animation evaluation takes */
+	unsigned int priority_count[ETCH_PRIORITIES]; /** Animations of every priority on the last tick with a budget */
 	/* TODO do we need to cache the next animation to be animated here? */
 };
 
@@ -87,13 +281,38 @@ typedef struct _Etch_Animation_Quadratic
 } Etch_Animation_Quadratic;
 
 
+/**
+ * Specific data needed for steps animations
+ */
+typedef struct _Etch_Animation_Steps
+{
+	unsigned int steps; /** Number of steps */
+} Etch_Animation_Steps;
+
+/**
+ * Specific data needed for spring animations. The spring goes from the value
+ * of the keyframe to the value of the next one in duration seconds, no matter
+ * the real length of the segment
+ */
+typedef struct _Etch_Animation_Spring
+{
+	double w0; /** Undamped angular frequency */
+	double zeta; /** Damping ratio */
+	double v0; /** Initial velocity, in distances per second */
+	double duration; /** Settle time in seconds */
+} Etch_Animation_Spring;
+
 typedef union _Etch_Interpolator_Type_Data
 {
 	Etch_Animation_Cubic c;
 	Etch_Animation_Quadratic q;
+	Etch_Animation_Steps s;
+	Etch_Animation_Spring sp;
 } Etch_Interpolator_Type_Data;
 
 
+typedef double (*Etch_Animation_Interpolator_Calc)(double m, Etch_Interpolator_Type_Data *data);
+
 /**
  * An animation mark is a defined state on the timeline of an animation. It sets
  * that a given time a property should have the specified value.
@@ -111,48 +330,184 @@ struct _Etch_Animation_Keyframe
 	Etch_Interpolator_Type_Data idata; /** interpolator specific data */
 	void *data;
 	Etch_Free data_free;
+	unsigned int record_id; /** serial on the record log, 0 if not recorded */
 };
 
+/**
+ * Calc and interpolate a value between two keyframes in one call. The
+ * returned value is the calculated m
+ */
+typedef double (*Etch_Kernel)(Etch_Animation_Keyframe *start,
+		Etch_Animation_Keyframe *end, double m, Etch_Data *res);
+
+typedef struct _Etch_Track Etch_Track;
+
 /**
  * Many objects can use the same animation.
  */
 struct _Etch_Animation
 {
-	EINA_INLIST; /** An animation is a list */
 	Eina_Inlist *keys; /** list of keyframes ordered */
 	/* we can not iterate through the keys and modify the time given that inmediately
 	 * the keys will be ordered */
 	Eina_List *unordered; /** list of keyframes unordered */
 	Etch *etch; /** Etch having this animation */
-	/* TODO if the marks are already ordered do we need to have the start
-	 * and end time duplicated here? */
-	Etch_Time start; /** initial time */
-	Etch_Time end; /** end time already */
-	/* TODO make m a fixed point var of type 1.31 */
-	double m; /** last interpolator value in the range [0,1] */
-	Etch_Data prev; /** previous value in the whole animation */
-	Etch_Data curr; /** current value in the whole animation */
-	int repeat; /** number of times the animation will repeat, -1 for infinite */
+	unsigned int id; /** Unique id of the animation on its Etch */
+	unsigned int index; /** Index of the state on the Etch */
+	Etch_Animation_State *detached; /** The state while not being on the Etch */
 	Etch_Data_Type dtype; /** animations only animates data types, no properties */
 	Etch_Interpolator interpolator; /** the interpolator to use for the requested data type */
+	Etch_Kernel *kernels; /** the kernels of the data type indexed by the interpolator type */
+	Etch_Track *track; /** the compact keyframes, if any */
+	/* the segment and time of the last evaluation, a modification of
+	 * the keyframes only needs to evaluate it again when it touches
+	 * that segment */
+	Etch_Animation_Keyframe *seg_start;
+	Etch_Animation_Keyframe *seg_end;
+	Etch_Time last;
+	Eina_Bool dirty; /** already on the dirty animations of the Etch */
+	void *bind; /** memory to store the value to instead of calling the callback */
+	size_t bind_size;
+	uint32_t *bind_dirty; /** bitmap to mark when the bound value changes */
+	unsigned int bind_bit;
 	Etch_Animation_Callback cb; /** function to call when a value has been set */
 	Etch_Animation_State_Callback start_cb;
 	Etch_Animation_State_Callback stop_cb;
 	Etch_Animation_State_Callback repeat_cb;
 	void *data; /** user provided data */
+	Etch_Animation_Marker *markers; /** markers ordered by time */
+	unsigned int markers_count;
+	unsigned int markers_size;
+	Etch_Blend *blend; /** blend the animation is a layer or a weight of */
+	Etch_Export *export; /** exporter the animation is on a slot of */
+	unsigned int export_slot;
+	unsigned int record_id; /** serial on the record log, 0 if not recorded */
 	int count; /** number of keyframes this animation has */
-	Eina_Bool enabled;/** easy way to disable/enable an animation */
-	Eina_Bool started;
-	Etch_Time offset; /*  the real offset */
+	Eina_Bool unsorted; /** keyframe times changed but the keys are not ordered yet */
 };
 
-void etch_animation_process(Etch_Animation *a);
-void etch_animation_animate(Etch_Animation *a, Etch_Time curr);
+static inline Etch_Animation_State * etch_animation_state_get(Etch_Animation *a)
+{
+	if (a->detached)
+		return a->detached;
+	return &a->etch->states[a->index];
+}
+
+/* Size of the native value of a data type, zero for the external one */
+static inline size_t etch_data_size(Etch_Data_Type dtype)
+{
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		return sizeof(uint32_t);
+
+		case ETCH_INT32:
+		return sizeof(int32_t);
+
+		case ETCH_FLOAT:
+		return sizeof(float);
+
+		case ETCH_DOUBLE:
+		return sizeof(double);
+
+		case ETCH_ARGB:
+		return sizeof(uint32_t);
+
+		case ETCH_STRING:
+		return sizeof(char *);
+
+		default:
+		return 0;
+	}
+}
+
+/* The time of the keyframes of an animation at some time of a repeat */
+static inline Etch_Time etch_animation_time_position(Etch_Animation_State *s,
+		uint64_t repeat, Etch_Time t)
+{
+	if (s->direction == ETCH_ANIMATION_REVERSE ||
+			(s->direction == ETCH_ANIMATION_ALTERNATE && (repeat & 1)))
+		return s->end - t;
+	return s->start + t;
+}
+
+/* Map a time of the Etch to the time of the keyframes of an animation, the
+ * times out of the animation are clamped to its start and end, the end
+ * included so it is not taken as the start of another repeat. The
+ * animation must have a length */
+static inline Etch_Time etch_animation_time_map(Etch_Animation_State *s, Etch_Time t)
+{
+	Etch_Time length = s->end - s->start;
+
+	if (t < s->start + s->offset)
+		return etch_animation_time_position(s, 0, 0);
+	if (s->repeat >= 0 && t >= (s->end * s->repeat) + s->offset)
+		return etch_animation_time_position(s, s->repeat ? s->repeat - 1 : 0, length);
+	t -= s->start + s->offset;
+	return etch_animation_time_position(s, t / length, t % length);
+}
+
+void etch_animation_process(Etch *e, unsigned int index, Etch_Time step);
+void etch_animation_animate(Etch_Animation *a, Etch_Animation_State *s, Etch_Time curr);
+void etch_animation_lazy_evaluate(Etch_Animation *a, Etch_Animation_State *s);
+void etch_animation_keyframes_sort(Etch_Animation *a);
 Etch_Animation * etch_animation_new(Etch *e, Etch_Data_Type dtype,
 		Etch_Interpolator interpolator, Etch_Animation_Callback cb,
 		Etch_Animation_State_Callback start, Etch_Animation_State_Callback stop,
 		Etch_Animation_State_Callback repeat, void *prev, void *curr, void *data);
 
+void etch_animation_append(Etch *e, Etch_Animation *a);
+void etch_animation_keyframe_free(Etch_Animation_Keyframe *k);
+void etch_animation_dirty(Etch_Animation *a);
+void etch_dirty_process(Etch *e, Eina_Bool all);
+Eina_Bool etch_next_event_get(Etch *e, Etch_Time *t);
+unsigned int etch_id_new(Etch *e);
+void etch_id_free(Etch *e, unsigned int id);
+
+void etch_snapshot_publish(Etch *e);
+void etch_snapshot_free(Etch_Snapshot *s);
+
+Etch_Track * etch_track_new(Etch_Animation *a, unsigned int bits);
+void etch_track_free(Etch_Track *t);
+unsigned int etch_track_size_get(Etch_Track *t);
+Eina_Bool etch_track_segment_get(Etch_Track *t, Etch_Data_Type dtype,
+		Etch_Time curr, Etch_Animation_Keyframe *keys,
+		Etch_Animation_Keyframe **start, Etch_Animation_Keyframe **end);
+
+void etch_event_queue_collect(Etch *e, unsigned int index);
+void etch_event_queue_end(Etch *e);
+void etch_event_queue_shutdown(Etch_Event_Queue *q);
+void etch_animation_markers_free(Etch_Animation *a);
+
+void etch_blend_process(Etch *e);
+void etch_blend_animation_remove(Etch_Animation *a);
+void etch_blend_shutdown(Etch *e);
+
+void etch_export_publish(Etch_Export *ex);
+void etch_export_animation_remove(Etch_Animation *a);
+
+void etch_record_timer(Etch *e, Etch_Record_Op op, int64_t arg);
+void etch_record_animation_add(Etch_Animation *a);
+void etch_record_animation(Etch_Animation *a, Etch_Record_Op op, int64_t arg);
+void etch_record_animation_params(Etch_Animation *a, Etch_Record_Op op,
+		const double *p, unsigned int count);
+void etch_record_keyframe_add(Etch_Animation_Keyframe *k);
+void etch_record_keyframe(Etch_Animation_Keyframe *k, Etch_Record_Op op, int64_t arg);
+void etch_record_keyframe_value(Etch_Animation_Keyframe *k, const Etch_Data *v);
+void etch_record_keyframe_params(Etch_Animation_Keyframe *k, Etch_Record_Op op,
+		const double *p, unsigned int count);
+void etch_record_shutdown(Etch *e);
+
+void etch_command_queue_init(Etch_Command_Queue *q);
+void etch_command_queue_shutdown(Etch_Command_Queue *q);
+void etch_command_queue_process(Etch *e);
+
+extern Etch_Animation_Interpolator_Calc etch_calcs[ETCH_PRECISIONS][ETCH_INTERPOLATOR_TYPES];
+extern Etch_Kernel etch_kernels[ETCH_PRECISIONS][ETCH_DATATYPES][ETCH_INTERPOLATOR_TYPES];
+
+Eina_Bool etch_interpolator_spring_setup(Etch_Animation_Spring *s,
+		double stiffness, double damping, double velocity);
+
 void etch_interpolator_uint32(Etch_Data *a, Etch_Data *b, double m, Etch_Data *res, void *data);
 void etch_interpolator_int32(Etch_Data *a, Etch_Data *b, double m, Etch_Data *res, void *data);
 void etch_interpolator_string(Etch_Data *a, Etch_Data *b, double m, Etch_Data *res, void *data);
@@ -0,0 +1,812 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+#include <time.h>
+
+/**
+ * The log starts with a magic and a version, followed by one record per
+ * call: the operation byte, the time since the previous record as a varint
+ * and the arguments. Integers are varints, zigzag encoded when signed, and
+ * doubles are stored raw. The animations and keyframes are referenced by a
+ * serial given when they are created while recording, so the operations on
+ * objects created before the recording started are not logged.
+ * The timer operations are logged once the pending commands have been
+ * applied, the commands being logged as the calls they translate to, so
+ * replaying the log in order applies everything on the same tick.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+#define RECORD_MAGIC "ETCHREC"
+#define RECORD_VERSION 2
+
+struct _Etch_Record
+{
+	FILE *f;
+	Etch_Time last; /** Time of the previous record */
+	unsigned int animations; /** Last animation serial */
+	unsigned int keyframes; /** Last keyframe serial */
+};
+
+struct _Etch_Replay
+{
+	Etch *etch;
+	unsigned char *data; /** The whole log */
+	size_t size;
+	size_t pos;
+	Etch_Time time; /** Time of the current record since the start */
+	Etch_Animation **animations; /** Animation of every serial */
+	unsigned int animations_size;
+	unsigned int animations_count; /** Last animation serial */
+	Etch_Animation_Keyframe **keyframes; /** Keyframe of every serial */
+	unsigned int keyframes_size;
+	unsigned int keyframes_count; /** Last keyframe serial */
+};
+
+static Etch_Time _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (Etch_Time)ts.tv_sec * ETCH_SECOND + ts.tv_nsec;
+}
+
+static void _put_varint(Etch_Record *r, uint64_t v)
+{
+	unsigned char buf[10];
+	int n = 0;
+
+	do
+	{
+		buf[n] = v & 0x7f;
+		v >>= 7;
+		if (v) buf[n] |= 0x80;
+		n++;
+	} while (v);
+	fwrite(buf, 1, n, r->f);
+}
+
+static inline void _put_svarint(Etch_Record *r, int64_t v)
+{
+	_put_varint(r, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void _put_header(Etch_Record *r, Etch_Record_Op op)
+{
+	Etch_Time now = _now();
+
+	fputc(op, r->f);
+	_put_varint(r, now - r->last);
+	r->last = now;
+}
+
+static void _put_doubles(Etch_Record *r, const double *p, unsigned int count)
+{
+	fwrite(p, sizeof(double), count, r->f);
+}
+
+static Eina_Bool _get_varint(Etch_Replay *r, uint64_t *v)
+{
+	unsigned int shift = 0;
+
+	*v = 0;
+	while (r->pos < r->size && shift < 64)
+	{
+		unsigned char c = r->data[r->pos++];
+
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return EINA_TRUE;
+		shift += 7;
+	}
+	return EINA_FALSE;
+}
+
+static Eina_Bool _get_svarint(Etch_Replay *r, int64_t *v)
+{
+	uint64_t u;
+
+	if (!_get_varint(r, &u))
+		return EINA_FALSE;
+	*v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+	return EINA_TRUE;
+}
+
+static Eina_Bool _get_doubles(Etch_Replay *r, double *p, unsigned int count)
+{
+	size_t size = sizeof(double) * count;
+
+	if (r->size - r->pos < size)
+		return EINA_FALSE;
+	memcpy(p, r->data + r->pos, size);
+	r->pos += size;
+	return EINA_TRUE;
+}
+
+static Etch_Animation * _animation_get(Etch_Replay *r, uint64_t *id)
+{
+	if (!_get_varint(r, id) || *id >= r->animations_size)
+		return NULL;
+	return r->animations[*id];
+}
+
+static Etch_Animation_Keyframe * _keyframe_get(Etch_Replay *r, uint64_t *id)
+{
+	if (!_get_varint(r, id) || *id >= r->keyframes_size)
+		return NULL;
+	return r->keyframes[*id];
+}
+
+/* the serials are given in order while recording, so a serial after the
+ * next one can only come from a corrupted log */
+static Eina_Bool _serial_set(void ***array, unsigned int *size,
+		unsigned int *count, uint64_t id, void *p)
+{
+	if (id > (uint64_t)*count + 1)
+		return EINA_FALSE;
+	if (id >= *size)
+	{
+		unsigned int nsize = *size ? *size * 2 : 64;
+
+		if (nsize <= id)
+			return EINA_FALSE;
+		*array = realloc(*array, sizeof(void *) * nsize);
+		memset(*array + *size, 0, sizeof(void *) * (nsize - *size));
+		*size = nsize;
+	}
+	(*array)[id] = p;
+	if (id > *count)
+		*count = id;
+	return EINA_TRUE;
+}
+
+/* get the serials of the keyframes of an animation, before an operation
+ * that can free them */
+static unsigned int _keyframes_serials_get(Etch_Replay *r, Etch_Animation *a,
+		unsigned int **serials)
+{
+	unsigned int count = 0;
+	unsigned int i;
+
+	*serials = malloc(sizeof(unsigned int) * (a->count + 1));
+	for (i = 1; i <= r->keyframes_count && count < (unsigned int)a->count; i++)
+	{
+		if (r->keyframes[i] && r->keyframes[i]->animation == a)
+			(*serials)[count++] = i;
+	}
+	return count;
+}
+
+/* forget the serials of the keyframes that are not on the animation after
+ * the operation, every one of them if the animation was deleted */
+static void _keyframes_forget(Etch_Replay *r, Etch_Animation *a,
+		unsigned int *serials, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+	{
+		Etch_Animation_Keyframe *k;
+		Etch_Animation_Keyframe *kept = NULL;
+
+		if (a)
+		{
+			EINA_INLIST_FOREACH(a->keys, k)
+			{
+				if (k == r->keyframes[serials[i]])
+				{
+					kept = k;
+					break;
+				}
+			}
+		}
+		if (!kept)
+			r->keyframes[serials[i]] = NULL;
+	}
+	free(serials);
+}
+
+static void _replay_cb(Etch_Animation_Keyframe *k, const Etch_Data *curr,
+		const Etch_Data *prev, void *data)
+{
+}
+
+static Eina_Bool _value_get(Etch_Replay *r, Etch_Data_Type dtype, Etch_Data *v)
+{
+	uint64_t u;
+	int64_t i;
+	char *s;
+
+	v->type = dtype;
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		case ETCH_ARGB:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		v->data.u32 = u;
+		return EINA_TRUE;
+
+		case ETCH_INT32:
+		if (!_get_svarint(r, &i)) return EINA_FALSE;
+		v->data.i32 = i;
+		return EINA_TRUE;
+
+		case ETCH_FLOAT:
+		if (r->size - r->pos < sizeof(float)) return EINA_FALSE;
+		memcpy(&v->data.f, r->data + r->pos, sizeof(float));
+		r->pos += sizeof(float);
+		return EINA_TRUE;
+
+		case ETCH_DOUBLE:
+		return _get_doubles(r, &v->data.d, 1);
+
+		case ETCH_STRING:
+		if (!_get_varint(r, &u) || r->size - r->pos < u)
+			return EINA_FALSE;
+		s = malloc(u + 1);
+		memcpy(s, r->data + r->pos, u);
+		s[u] = '\0';
+		r->pos += u;
+		v->data.string = s;
+		return EINA_TRUE;
+
+		default:
+		return EINA_FALSE;
+	}
+}
+
+/* Execute the arguments of an operation, the animations and keyframes not
+ * found are skipped */
+static Eina_Bool _replay_op(Etch_Replay *r, Etch_Record_Op op)
+{
+	Etch_Animation_Keyframe *k;
+	Etch_Animation *a;
+	Etch_Data v;
+	double p[4];
+	unsigned int *serials;
+	unsigned int count;
+	uint64_t dtype;
+	uint64_t id;
+	uint64_t u;
+	int64_t i;
+
+	switch (op)
+	{
+		case ETCH_RECORD_TIMER_FPS:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		etch_timer_fps_set(r->etch, u);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_TIMER_TICK:
+		etch_timer_tick(r->etch);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_TIMER_TICK_BUDGET:
+		if (!_get_svarint(r, &i)) return EINA_FALSE;
+		etch_timer_tick_budget(r->etch, i, NULL);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_TIMER_SET:
+		if (!_get_svarint(r, &i)) return EINA_FALSE;
+		etch_timer_set(r->etch, i);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_TIMER_GOTO:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		etch_timer_goto(r->etch, u);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_FLUSH:
+		etch_flush(r->etch);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_PRECISION:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		etch_precision_set(r->etch, u);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_ANIMATION_ADD:
+		if (!_get_varint(r, &u) || !_get_varint(r, &dtype))
+			return EINA_FALSE;
+		a = etch_animation_add(r->etch, dtype, _replay_cb, NULL, NULL, NULL, NULL);
+		return _serial_set((void ***)&r->animations, &r->animations_size,
+				&r->animations_count, u, a);
+
+		case ETCH_RECORD_KEYFRAME_ADD:
+		a = _animation_get(r, &id);
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		if (a)
+			return _serial_set((void ***)&r->keyframes,
+					&r->keyframes_size, &r->keyframes_count,
+					u, etch_animation_keyframe_add(a));
+		return EINA_TRUE;
+
+		default:
+		break;
+	}
+
+	if (op <= ETCH_RECORD_ANIMATION_COMPACT)
+	{
+		a = _animation_get(r, &id);
+		switch (op)
+		{
+			case ETCH_RECORD_ANIMATION_DELETE:
+			if (!a) return EINA_TRUE;
+			count = _keyframes_serials_get(r, a, &serials);
+			etch_animation_delete(a);
+			_keyframes_forget(r, NULL, serials, count);
+			r->animations[id] = NULL;
+			return EINA_TRUE;
+
+			case ETCH_RECORD_ANIMATION_REMOVE:
+			if (a) etch_animation_remove(r->etch, a);
+			return EINA_TRUE;
+
+			case ETCH_RECORD_ANIMATION_ENABLE:
+			if (a) etch_animation_enable(a);
+			return EINA_TRUE;
+
+			case ETCH_RECORD_ANIMATION_ENABLE_DEFERRED:
+			/* as the command does, the process is done on the tick */
+			if (a) etch_animation_state_get(a)->enabled = EINA_TRUE;
+			return EINA_TRUE;
+
+			case ETCH_RECORD_ANIMATION_DISABLE:
+			if (a) etch_animation_disable(a);
+			return EINA_TRUE;
+
+			case ETCH_RECORD_ANIMATION_SIMPLIFY:
+			if (!_get_doubles(r, p, 1)) return EINA_FALSE;
+			if (!a) return EINA_TRUE;
+			count = _keyframes_serials_get(r, a, &serials);
+			etch_animation_simplify(a, p[0]);
+			_keyframes_forget(r, a, serials, count);
+			return EINA_TRUE;
+
+			default:
+			break;
+		}
+		if (!_get_svarint(r, &i)) return EINA_FALSE;
+		if (!a) return EINA_TRUE;
+		switch (op)
+		{
+			case ETCH_RECORD_ANIMATION_REPEAT:
+			etch_animation_repeat_set(a, i);
+			break;
+
+			case ETCH_RECORD_ANIMATION_OFFSET:
+			etch_animation_offset_add(a, i);
+			break;
+
+			case ETCH_RECORD_ANIMATION_DIRECTION:
+			etch_animation_direction_set(a, i);
+			break;
+
+			case ETCH_RECORD_ANIMATION_PRIORITY:
+			etch_animation_priority_set(a, i);
+			break;
+
+			case ETCH_RECORD_ANIMATION_LAZY:
+			etch_animation_lazy_set(a, i);
+			break;
+
+			case ETCH_RECORD_ANIMATION_COMPACT:
+			count = _keyframes_serials_get(r, a, &serials);
+			etch_animation_compact(a, i);
+			_keyframes_forget(r, a, serials, count);
+			break;
+
+			default:
+			return EINA_FALSE;
+		}
+		return EINA_TRUE;
+	}
+
+	k = _keyframe_get(r, &id);
+	switch (op)
+	{
+		case ETCH_RECORD_KEYFRAME_REMOVE:
+		if (!k) return EINA_TRUE;
+		etch_animation_keyframe_remove(k->animation, k);
+		r->keyframes[id] = NULL;
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_TYPE:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_type_set(k, u);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_TIME:
+		if (!_get_svarint(r, &i)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_time_set(k, i);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_STEPS:
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_steps_value_set(k, u);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_VALUE:
+		/* the data type is the one of the animation */
+		if (!_get_varint(r, &u)) return EINA_FALSE;
+		if (!_value_get(r, u, &v)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_value_set(k, &v);
+		if (u == ETCH_STRING) free(v.data.string);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_QUADRATIC:
+		if (!_get_doubles(r, p, 2)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_quadratic_value_set(k, p[0], p[1]);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_CUBIC:
+		if (!_get_doubles(r, p, 4)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_cubic_value_set(k, p[0], p[1], p[2], p[3]);
+		return EINA_TRUE;
+
+		case ETCH_RECORD_KEYFRAME_SPRING:
+		if (!_get_doubles(r, p, 3)) return EINA_FALSE;
+		if (k) etch_animation_keyframe_spring_value_set(k, p[0], p[1], p[2]);
+		return EINA_TRUE;
+
+		default:
+		return EINA_FALSE;
+	}
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+void etch_record_timer(Etch *e, Etch_Record_Op op, int64_t arg)
+{
+	Etch_Record *r = e->record;
+
+	_put_header(r, op);
+	switch (op)
+	{
+		case ETCH_RECORD_TIMER_FPS:
+		case ETCH_RECORD_TIMER_GOTO:
+		case ETCH_RECORD_PRECISION:
+		_put_varint(r, arg);
+		break;
+
+		case ETCH_RECORD_TIMER_TICK_BUDGET:
+		case ETCH_RECORD_TIMER_SET:
+		_put_svarint(r, arg);
+		break;
+
+		default:
+		break;
+	}
+}
+
+void etch_record_animation_add(Etch_Animation *a)
+{
+	Etch_Record *r = a->etch->record;
+
+	a->record_id = ++r->animations;
+	_put_header(r, ETCH_RECORD_ANIMATION_ADD);
+	_put_varint(r, a->record_id);
+	_put_varint(r, a->dtype);
+}
+
+void etch_record_animation(Etch_Animation *a, Etch_Record_Op op, int64_t arg)
+{
+	Etch_Record *r = a->etch->record;
+
+	if (!a->record_id)
+		return;
+	_put_header(r, op);
+	_put_varint(r, a->record_id);
+	switch (op)
+	{
+		case ETCH_RECORD_ANIMATION_DELETE:
+		case ETCH_RECORD_ANIMATION_REMOVE:
+		case ETCH_RECORD_ANIMATION_ENABLE:
+		case ETCH_RECORD_ANIMATION_ENABLE_DEFERRED:
+		case ETCH_RECORD_ANIMATION_DISABLE:
+		break;
+
+		default:
+		_put_svarint(r, arg);
+		break;
+	}
+}
+
+void etch_record_animation_params(Etch_Animation *a, Etch_Record_Op op,
+		const double *p, unsigned int count)
+{
+	Etch_Record *r = a->etch->record;
+
+	if (!a->record_id)
+		return;
+	_put_header(r, op);
+	_put_varint(r, a->record_id);
+	_put_doubles(r, p, count);
+}
+
+void etch_record_keyframe_add(Etch_Animation_Keyframe *k)
+{
+	Etch_Record *r = k->animation->etch->record;
+
+	if (!k->animation->record_id)
+		return;
+	k->record_id = ++r->keyframes;
+	_put_header(r, ETCH_RECORD_KEYFRAME_ADD);
+	_put_varint(r, k->animation->record_id);
+	_put_varint(r, k->record_id);
+}
+
+void etch_record_keyframe(Etch_Animation_Keyframe *k, Etch_Record_Op op, int64_t arg)
+{
+	Etch_Record *r = k->animation->etch->record;
+
+	if (!k->record_id)
+		return;
+	_put_header(r, op);
+	_put_varint(r, k->record_id);
+	switch (op)
+	{
+		case ETCH_RECORD_KEYFRAME_REMOVE:
+		break;
+
+		case ETCH_RECORD_KEYFRAME_TIME:
+		_put_svarint(r, arg);
+		break;
+
+		default:
+		_put_varint(r, arg);
+		break;
+	}
+}
+
+void etch_record_keyframe_value(Etch_Animation_Keyframe *k, const Etch_Data *v)
+{
+	Etch_Record *r = k->animation->etch->record;
+	Etch_Data_Type dtype = k->animation->dtype;
+	size_t len;
+
+	if (!k->record_id)
+		return;
+	_put_header(r, ETCH_RECORD_KEYFRAME_VALUE);
+	_put_varint(r, k->record_id);
+	_put_varint(r, dtype);
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		case ETCH_ARGB:
+		_put_varint(r, v->data.u32);
+		break;
+
+		case ETCH_INT32:
+		_put_svarint(r, v->data.i32);
+		break;
+
+		case ETCH_FLOAT:
+		fwrite(&v->data.f, sizeof(float), 1, r->f);
+		break;
+
+		case ETCH_DOUBLE:
+		_put_doubles(r, &v->data.d, 1);
+		break;
+
+		case ETCH_STRING:
+		len = v->data.string ? strlen(v->data.string) : 0;
+		_put_varint(r, len);
+		fwrite(v->data.string, 1, len, r->f);
+		break;
+
+		default:
+		break;
+	}
+}
+
+void etch_record_keyframe_params(Etch_Animation_Keyframe *k, Etch_Record_Op op,
+		const double *p, unsigned int count)
+{
+	Etch_Record *r = k->animation->etch->record;
+
+	if (!k->record_id)
+		return;
+	_put_header(r, op);
+	_put_varint(r, k->record_id);
+	_put_doubles(r, p, count);
+}
+
+void etch_record_shutdown(Etch *e)
+{
+	if (e->record)
+		etch_record_stop(e);
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Start logging the calls made on an Etch to a file. The log can be
+ * replayed later with etch_replay_new(), for example to benchmark real
+ * workloads. Only the animations created after the recording started are
+ * logged, so it is better started right after etch_new(). The external
+ * animations, the bindings, the blends, the markers and the checkpoints are
+ * not logged, neither are the calls that only read values:
+ * etch_animation_data_get(), etch_animation_sample() and
+ * etch_block_render(). The lazy animations are evaluated by those calls, so
+ * their cost is not part of a replay
+ * @param e The Etch instance
+ * @param file The file to write the log to
+ * @return EINA_TRUE if the recording has started, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_record_start(Etch *e, const char *file)
+{
+	Etch_Record *r;
+	FILE *f;
+
+	assert(e);
+	assert(file);
+	if (e->record)
+		return EINA_FALSE;
+	f = fopen(file, "wb");
+	if (!f)
+	{
+		ERR("Can not open the record file %s", file);
+		return EINA_FALSE;
+	}
+	fwrite(RECORD_MAGIC, 1, sizeof(RECORD_MAGIC), f);
+	fputc(RECORD_VERSION, f);
+
+	r = calloc(1, sizeof(Etch_Record));
+	r->f = f;
+	r->last = _now();
+	e->record = r;
+	/* the replay starts from the same frame rate, time and precision */
+	etch_record_timer(e, ETCH_RECORD_TIMER_FPS, e->fps);
+	etch_record_timer(e, ETCH_RECORD_TIMER_SET, e->curr);
+	etch_record_timer(e, ETCH_RECORD_PRECISION, e->precision);
+	return EINA_TRUE;
+}
+/**
+ * Stop logging the calls made on an Etch and close the log file
+ * @param e The Etch instance
+ */
+EAPI void etch_record_stop(Etch *e)
+{
+	assert(e);
+	if (!e->record)
+		return;
+	fclose(e->record->f);
+	free(e->record);
+	e->record = NULL;
+}
+/**
+ * Load a log written with etch_record_start() to replay it on a new Etch
+ * @param file The log file
+ * @return The new replay or NULL in case of error
+ */
+EAPI Etch_Replay * etch_replay_new(const char *file)
+{
+	Etch_Replay *r;
+	unsigned char header[sizeof(RECORD_MAGIC) + 1];
+	FILE *f;
+	long size;
+
+	assert(file);
+	f = fopen(file, "rb");
+	if (!f)
+		return NULL;
+	if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+			memcmp(header, RECORD_MAGIC, sizeof(RECORD_MAGIC)) ||
+			header[sizeof(RECORD_MAGIC)] != RECORD_VERSION)
+	{
+		ERR("The file %s is not a record log", file);
+		fclose(f);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f) - sizeof(header);
+	fseek(f, sizeof(header), SEEK_SET);
+
+	r = calloc(1, sizeof(Etch_Replay));
+	r->data = malloc(size > 0 ? size : 1);
+	r->size = fread(r->data, 1, size, f);
+	fclose(f);
+	r->etch = etch_new();
+	return r;
+}
+/**
+ * Delete a replay and its Etch
+ * @param r The replay
+ */
+EAPI void etch_replay_delete(Etch_Replay *r)
+{
+	unsigned int i;
+
+	assert(r);
+	for (i = 0; i < r->animations_size; i++)
+	{
+		if (r->animations[i])
+			etch_animation_delete(r->animations[i]);
+	}
+	etch_delete(r->etch);
+	free(r->animations);
+	free(r->keyframes);
+	free(r->data);
+	free(r);
+}
+/**
+ * Get the Etch a replay executes the log on
+ * @param r The replay
+ * @return The Etch instance
+ */
+EAPI Etch * etch_replay_etch_get(Etch_Replay *r)
+{
+	assert(r);
+	return r->etch;
+}
+/**
+ * Get the time of the next call of a replay without executing it, to wait
+ * before the call when replaying at the recorded pace
+ * @param r The replay
+ * @param t The location to store the time of the call since the recording
+ * started
+ * @return EINA_TRUE if there is a next call, EINA_FALSE at the end of the
+ * log or if it is corrupt
+ */
+EAPI Eina_Bool etch_replay_next_time_get(Etch_Replay *r, Etch_Time *t)
+{
+	size_t pos;
+	uint64_t dt;
+	Eina_Bool ret;
+
+	assert(r);
+	assert(t);
+	if (r->pos >= r->size)
+		return EINA_FALSE;
+	pos = r->pos++;
+	ret = _get_varint(r, &dt);
+	r->pos = pos;
+	if (!ret)
+		return EINA_FALSE;
+	*t = r->time + dt;
+	return EINA_TRUE;
+}
+/**
+ * Execute the next call of a replay
+ * @param r The replay
+ * @param t The location to store the time of the call since the recording
+ * started, can be NULL
+ * @param timer The location to store whenever the call moved the timer, can
+ * be NULL
+ * @return EINA_TRUE if a call has been executed, EINA_FALSE at the end of
+ * the log or if it is corrupt
+ */
+EAPI Eina_Bool etch_replay_step(Etch_Replay *r, Etch_Time *t, Eina_Bool *timer)
+{
+	Etch_Record_Op op;
+	uint64_t dt;
+
+	assert(r);
+	if (r->pos >= r->size)
+		return EINA_FALSE;
+	op = r->data[r->pos++];
+	if (op >= ETCH_RECORD_OPS || !_get_varint(r, &dt))
+		return EINA_FALSE;
+	r->time += dt;
+	if (t) *t = r->time;
+	if (timer) *timer = op <= ETCH_RECORD_TIMER_GOTO && op != ETCH_RECORD_TIMER_FPS;
+	return _replay_op(r, op);
+}
@@ -0,0 +1,260 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The sampling evaluates an animation at arbitrary times without touching
+ * its state nor calling any callback. The segment of the previous sample is
+ * kept, so consecutive times only walk forward over the keyframes.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+typedef struct _Etch_Sample_Cursor
+{
+	Etch_Animation *a;
+	Etch_Animation_Keyframe *start;
+	Etch_Animation_Keyframe *end;
+	/* the keyframes of a compacted animation are decoded here, the ones of
+	 * the track belong to the evaluation of the animation */
+	Etch_Animation_Keyframe keys[2];
+} Etch_Sample_Cursor;
+
+/* find the segment of a time of the keyframes, starting from the segment of
+ * the previous sample when the time is after it */
+static Eina_Bool _segment_find(Etch_Sample_Cursor *c, Etch_Time t)
+{
+	Eina_Inlist *l;
+
+	if (c->a->track)
+		return etch_track_segment_get(c->a->track, c->a->dtype, t,
+				c->keys, &c->start, &c->end);
+
+	if (c->start && c->start->time <= t && t <= c->end->time)
+		return EINA_TRUE;
+	l = (c->start && c->start->time <= t) ? EINA_INLIST_GET(c->end) :
+			(Eina_Inlist *)c->a->keys;
+	for (; l; l = l->next)
+	{
+		if (!l->next)
+			break;
+		c->start = (Etch_Animation_Keyframe *)l;
+		c->end = (Etch_Animation_Keyframe *)l->next;
+		if (c->start->time <= t && t <= c->end->time)
+			return EINA_TRUE;
+	}
+	c->start = c->end = NULL;
+	return EINA_FALSE;
+}
+
+static inline Eina_Bool _evaluate(Etch_Sample_Cursor *c, Etch_Time t,
+		Etch_Data *res)
+{
+	double m;
+
+	if (!_segment_find(c, t))
+		return EINA_FALSE;
+	if (t == c->start->time)
+		m = 0;
+	else if (t == c->end->time)
+		m = 1;
+	else
+		m = (double)(t - c->start->time) / (c->end->time - c->start->time);
+	c->a->kernels[c->start->type](c->start, c->end, m, res);
+	return EINA_TRUE;
+}
+
+/* check that an animation can be sampled without modifying it */
+static Eina_Bool _sampleable(Etch_Animation *a)
+{
+	Etch_Animation_State *s;
+
+	if (!a->kernels || a->unsorted)
+		return EINA_FALSE;
+	if (!a->keys && !a->track)
+		return EINA_FALSE;
+	s = etch_animation_state_get(a);
+	if (!(s->end - s->start))
+		return EINA_FALSE;
+	return EINA_TRUE;
+}
+
+static unsigned int _sample(Etch_Animation *a, const Etch_Time *times,
+		Etch_Time t0, Etch_Time dt, unsigned int n, void *out)
+{
+	Etch_Sample_Cursor c;
+	Etch_Animation_State *s;
+	unsigned char *o = out;
+	size_t size;
+	unsigned int i;
+
+	assert(a);
+	assert(out);
+
+	size = etch_data_size(a->dtype);
+	if (!size)
+		return 0;
+	if (a->unsorted)
+		etch_animation_keyframes_sort(a);
+	if (!_sampleable(a))
+		return 0;
+	s = etch_animation_state_get(a);
+
+	c.a = a;
+	c.start = c.end = NULL;
+	c.keys[0].animation = c.keys[1].animation = a;
+	for (i = 0; i < n; i++, o += size)
+	{
+		Etch_Data res;
+		Etch_Time t;
+
+		t = etch_animation_time_map(s, times ? times[i] : t0 + dt * i);
+		if (!_evaluate(&c, t, &res))
+			return i;
+		memcpy(o, &res.data, size);
+	}
+	return n;
+}
+
+/* Render a block of samples of a numeric animation. Nothing on this path
+ * can allocate, lock or log */
+static Eina_Bool _block_render(Etch_Animation *a, Etch_Time t0,
+		unsigned int rate, unsigned int n, float *out)
+{
+	Etch_Sample_Cursor c;
+	Etch_Animation_State *s;
+	unsigned int i;
+
+	switch (a->dtype)
+	{
+		case ETCH_UINT32:
+		case ETCH_INT32:
+		case ETCH_FLOAT:
+		case ETCH_DOUBLE:
+		break;
+
+		default:
+		return EINA_FALSE;
+	}
+	if (!_sampleable(a))
+		return EINA_FALSE;
+	s = etch_animation_state_get(a);
+
+	c.a = a;
+	c.start = c.end = NULL;
+	c.keys[0].animation = c.keys[1].animation = a;
+	for (i = 0; i < n; i++)
+	{
+		Etch_Data res;
+		Etch_Time t;
+
+		t = etch_animation_time_map(s, t0 + ((uint64_t)i * ETCH_SECOND) / rate);
+		if (!_evaluate(&c, t, &res))
+			return EINA_FALSE;
+		switch (a->dtype)
+		{
+			case ETCH_UINT32:
+			out[i] = res.data.u32;
+			break;
+
+			case ETCH_INT32:
+			out[i] = res.data.i32;
+			break;
+
+			case ETCH_FLOAT:
+			out[i] = res.data.f;
+			break;
+
+			default:
+			out[i] = res.data.d;
+			break;
+		}
+	}
+	return EINA_TRUE;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Evaluate an animation at several times of the Etch. The values are
+ * written in the native type of the animation, uint32_t, int32_t, float,
+ * double or char * (interned, without a new reference), one after the
+ * other. The state of the animation is not modified and no callback is
+ * called. The times are best given in increasing order. External
+ * animations can not be sampled
+ * @param a The Etch_Animation
+ * @param times The times to evaluate
+ * @param n The number of times
+ * @param out The buffer to write the n values to
+ * @return The number of values written
+ */
+EAPI unsigned int etch_animation_sample(Etch_Animation *a, const Etch_Time *times,
+		unsigned int n, void *out)
+{
+	assert(times);
+	return _sample(a, times, 0, 0, n, out);
+}
+/**
+ * Evaluate an animation at regular times of the Etch. Same as
+ * etch_animation_sample() with the times t0, t0 + dt, t0 + 2dt, ...
+ * @param a The Etch_Animation
+ * @param t0 The first time to evaluate
+ * @param dt The time between two samples
+ * @param n The number of samples
+ * @param out The buffer to write the n values to
+ * @return The number of values written
+ */
+EAPI unsigned int etch_animation_sample_range(Etch_Animation *a, Etch_Time t0,
+		Etch_Time dt, unsigned int n, void *out)
+{
+	return _sample(a, NULL, t0, dt, n, out);
+}
+/**
+ * Render a block of audio rate samples of several numeric animations. The
+ * sample i of the block is the value at t0 + i / rate seconds. This function
+ * does not allocate, lock, log nor call any callback so it can be called
+ * from a real time thread, the animations and their keyframes must not be
+ * modified meanwhile. Animations of non numeric data types, without
+ * keyframes or with keyframes posted to be reordered are not rendered and
+ * their buffers are left untouched
+ * @param a The animations to render
+ * @param count The number of animations
+ * @param t0 The time of the first sample
+ * @param rate The sample rate in samples per second
+ * @param n The number of samples of the block
+ * @param out The buffers of n floats to render every animation to
+ * @return The number of animations rendered
+ */
+EAPI unsigned int etch_block_render(Etch_Animation **a, unsigned int count,
+		Etch_Time t0, unsigned int rate, unsigned int n, float **out)
+{
+	unsigned int rendered = 0;
+	unsigned int i;
+
+	assert(rate);
+	for (i = 0; i < count; i++)
+	{
+		if (_block_render(a[i], t0, rate, n, out[i]))
+			rendered++;
+	}
+	return rendered;
+}
@@ -0,0 +1,153 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * The writer always fills the buffer that was not published last, so a
+ * reader only has to retry when the writer wraps around the two buffers
+ * while it is still copying, that is, when the copy takes longer than a
+ * whole tick.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+void etch_snapshot_publish(Etch *e)
+{
+	Etch_Snapshot *s = e->snapshot;
+	Etch_Snapshot_Buffer *b;
+	unsigned int i;
+
+	b = &s->buffers[(s->generation + 1) & 1];
+	__atomic_store_n(&b->seq, b->seq + 1, __ATOMIC_RELAXED);
+	ETCH_ATOMIC_FENCE_RELEASE();
+	b->frame = e->frame;
+	b->time = e->curr;
+	for (i = 0; i < e->count; i++)
+	{
+		unsigned int id = e->animations[i]->id;
+
+		if (id >= s->size)
+			continue;
+		/* the strings and the external values are pointers owned by
+		 * the ticking thread, they can be freed while being read
+		 */
+		if (e->animations[i]->dtype == ETCH_STRING ||
+				e->animations[i]->dtype == ETCH_EXTERNAL)
+		{
+			b->values[id].type = ETCH_DATATYPES;
+			continue;
+		}
+		/* other threads can not evaluate the lazy animations */
+		if (e->states[i].stale)
+			etch_animation_lazy_evaluate(e->animations[i], &e->states[i]);
+		b->values[id] = e->states[i].curr;
+	}
+	ETCH_ATOMIC_STORE(&b->seq, b->seq + 1);
+	ETCH_ATOMIC_STORE(&s->generation, s->generation + 1);
+}
+
+void etch_snapshot_free(Etch_Snapshot *s)
+{
+	free(s->buffers[0].values);
+	free(s->buffers[1].values);
+	free(s);
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Enable the publishing of the animation values at the end of every tick.
+ * Only the numeric and color values are published
+ * @param e The Etch instance
+ * @param size Number of values to publish. Only the animations with an id
+ * lower than this are published
+ */
+EAPI void etch_snapshot_enable(Etch *e, unsigned int size)
+{
+	Etch_Snapshot *s;
+
+	assert(e);
+	if (e->snapshot)
+		etch_snapshot_disable(e);
+	s = calloc(1, sizeof(Etch_Snapshot));
+	s->size = size;
+	s->buffers[0].values = calloc(size, sizeof(Etch_Data));
+	s->buffers[1].values = calloc(size, sizeof(Etch_Data));
+	e->snapshot = s;
+	etch_snapshot_publish(e);
+}
+/**
+ * Disable the publishing of the animation values. No other thread must be
+ * reading the snapshot when this is called
+ * @param e The Etch instance
+ */
+EAPI void etch_snapshot_disable(Etch *e)
+{
+	assert(e);
+	if (!e->snapshot)
+		return;
+	etch_snapshot_free(e->snapshot);
+	e->snapshot = NULL;
+}
+/**
+ * Read the last published values of a set of animations. All the values
+ * belong to the same tick. This function can be called from any thread
+ * and never blocks the ticking thread
+ * @param e The Etch instance
+ * @param a The animations to read
+ * @param count Number of animations to read
+ * @param values The array to store the values to. The animations that are
+ * not published, and the ETCH_STRING and ETCH_EXTERNAL animations, get a
+ * value of type ETCH_DATATYPES
+ * @param t The time of the values, can be NULL
+ */
+EAPI void etch_snapshot_read(Etch *e, Etch_Animation **a, unsigned int count,
+		Etch_Data *values, Etch_Time *t)
+{
+	Etch_Snapshot *s;
+	Etch_Snapshot_Buffer *b;
+	unsigned int seq;
+	unsigned int i;
+
+	assert(e);
+	assert(e->snapshot);
+
+	s = e->snapshot;
+	do
+	{
+		b = &s->buffers[ETCH_ATOMIC_LOAD(&s->generation) & 1];
+		seq = ETCH_ATOMIC_LOAD(&b->seq);
+		if (seq & 1)
+			continue;
+		for (i = 0; i < count; i++)
+		{
+			unsigned int id = a[i]->id;
+
+			if (id < s->size)
+				values[i] = b->values[id];
+			else
+				values[i].type = ETCH_DATATYPES;
+		}
+		if (t) *t = b->time;
+		ETCH_ATOMIC_FENCE_ACQUIRE();
+	} while ((seq & 1) || __atomic_load_n(&b->seq, __ATOMIC_RELAXED) != seq);
+}
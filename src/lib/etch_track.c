@@ -0,0 +1,450 @@
+/* ETCH - Timeline Based Animation Library
+ * Copyright (C) 2007-2008 Jorge Luis Zapata, Hisham Mardam-Bey
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Etch.h"
+#include "etch_private.h"
+
+/**
+ * A compact track stores the keyframes of an animation as a byte stream.
+ * Every keyframe is encoded as:
+ * - A header byte with the interpolator type and a flag telling if the
+ *   interpolator data follows.
+ * - The time as a zigzag varint, the difference between its delta with the
+ *   previous keyframe of the block and the previous delta, in units of the
+ *   greatest common divisor of every keyframe time. Keyframes captured at a
+ *   regular rate take a single byte.
+ * - The value quantized to 8 or 16 bits against the range of the track.
+ * - The interpolator data, only when it is not zero.
+ * The keyframes are grouped in blocks with the absolute time of its first
+ * keyframe, so the segment of a time is found with a binary search and
+ * decoding at most a block.
+ */
+/*============================================================================*
+ *                                  Local                                     *
+ *============================================================================*/
+#define ETCH_TRACK_BLOCK 16
+#define ETCH_TRACK_PAYLOAD (1 << 5)
+#define ETCH_TRACK_TYPE_MASK (ETCH_TRACK_PAYLOAD - 1)
+
+typedef struct _Etch_Track_Block
+{
+	Etch_Time time; /** Time of the first keyframe of the block */
+	unsigned int offset; /** Offset of the first keyframe on the stream */
+} Etch_Track_Block;
+
+struct _Etch_Track
+{
+	unsigned char *data; /** The encoded keyframes */
+	unsigned int size; /** Size of the encoded keyframes */
+	Etch_Track_Block *blocks;
+	unsigned int nblocks;
+	unsigned int count; /** Number of keyframes */
+	Etch_Time unit; /** Time unit of the deltas */
+	unsigned int bytes; /** Bytes of every quantized value */
+	double min; /** Minimum value of the track */
+	double scale; /** Value of every quantization step */
+	/* the decoded keyframes of the last evaluated segment, they are
+	 * the ones passed to the callbacks */
+	Etch_Animation_Keyframe keys[2];
+};
+
+static Etch_Time _gcd(Etch_Time a, Etch_Time b)
+{
+	while (b)
+	{
+		Etch_Time t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static unsigned int _payload_size(Etch_Interpolator_Type type)
+{
+	switch (type)
+	{
+		case ETCH_INTERPOLATOR_QUADRATIC:
+		return sizeof(Etch_Animation_Quadratic);
+
+		case ETCH_INTERPOLATOR_CUBIC:
+		return sizeof(Etch_Animation_Cubic);
+
+		case ETCH_INTERPOLATOR_STEPS:
+		return sizeof(Etch_Animation_Steps);
+
+		case ETCH_INTERPOLATOR_SPRING:
+		return sizeof(Etch_Animation_Spring);
+
+		default:
+		return 0;
+	}
+}
+
+static Eina_Bool _payload_empty(Etch_Animation_Keyframe *k, unsigned int size)
+{
+	const unsigned char *p = (const unsigned char *)&k->idata;
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		if (p[i]) return EINA_FALSE;
+	return EINA_TRUE;
+}
+
+static Eina_Bool _value_get(Etch_Data_Type dtype, Etch_Data *d, double *v)
+{
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		*v = d->data.u32;
+		return EINA_TRUE;
+
+		case ETCH_INT32:
+		*v = d->data.i32;
+		return EINA_TRUE;
+
+		case ETCH_FLOAT:
+		*v = d->data.f;
+		return EINA_TRUE;
+
+		case ETCH_DOUBLE:
+		*v = d->data.d;
+		return EINA_TRUE;
+
+		default:
+		return EINA_FALSE;
+	}
+}
+
+static void _value_set(Etch_Data_Type dtype, Etch_Data *d, double v)
+{
+	d->type = dtype;
+	switch (dtype)
+	{
+		case ETCH_UINT32:
+		d->data.u32 = lround(v);
+		break;
+
+		case ETCH_INT32:
+		d->data.i32 = lround(v);
+		break;
+
+		case ETCH_FLOAT:
+		d->data.f = v;
+		break;
+
+		default:
+		d->data.d = v;
+		break;
+	}
+}
+
+static unsigned char * _varint_write(unsigned char *p, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		*p++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static inline uint64_t _zigzag_encode(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t _zigzag_decode(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static const unsigned char * _varint_read(const unsigned char *p, uint64_t *v)
+{
+	uint64_t r = 0;
+	int shift = 0;
+
+	while (*p & 0x80)
+	{
+		r |= (uint64_t)(*p++ & 0x7f) << shift;
+		shift += 7;
+	}
+	r |= (uint64_t)*p++ << shift;
+	*v = r;
+	return p;
+}
+
+/* decode the keyframe at p, base is the time of the previous keyframe of
+ * the block and delta the previous delta, which is updated */
+static const unsigned char * _decode(Etch_Track *t, Etch_Data_Type dtype,
+		const unsigned char *p, Etch_Time base, int64_t *delta,
+		Etch_Animation_Keyframe *k)
+{
+	unsigned char header;
+	uint64_t dd;
+	unsigned int q;
+	unsigned int size;
+
+	header = *p++;
+	k->type = header & ETCH_TRACK_TYPE_MASK;
+	p = _varint_read(p, &dd);
+	*delta += _zigzag_decode(dd);
+	k->time = base + *delta * t->unit;
+	q = *p++;
+	if (t->bytes == 2)
+		q |= *p++ << 8;
+	_value_set(dtype, &k->value, t->min + q * t->scale);
+	memset(&k->idata, 0, sizeof(k->idata));
+	if (header & ETCH_TRACK_PAYLOAD)
+	{
+		size = _payload_size(k->type);
+		memcpy(&k->idata, p, size);
+		p += size;
+	}
+	return p;
+}
+/*============================================================================*
+ *                                 Global                                     *
+ *============================================================================*/
+/* Encode the ordered keyframes of an animation, the animation must be of
+ * a numeric data type */
+Etch_Track * etch_track_new(Etch_Animation *a, unsigned int bits)
+{
+	Etch_Track *t;
+	Etch_Animation_Keyframe *k;
+	Etch_Time unit = 0;
+	Etch_Time prev = 0;
+	int64_t delta = 0;
+	unsigned char *p;
+	double min = DBL_MAX, max = -DBL_MAX;
+	double v;
+	unsigned int levels;
+	unsigned int i = 0;
+
+	if (!a->keys)
+		return NULL;
+	/* the range of values and the time unit */
+	EINA_INLIST_FOREACH(a->keys, k)
+	{
+		if (!_value_get(a->dtype, &k->value, &v))
+			return NULL;
+		if (v < min) min = v;
+		if (v > max) max = v;
+		unit = _gcd(unit, k->time);
+	}
+	if (!unit) unit = 1;
+
+	t = calloc(1, sizeof(Etch_Track));
+	t->count = a->count;
+	t->unit = unit;
+	t->bytes = bits / 8;
+	t->min = min;
+	levels = (1 << bits) - 1;
+	t->scale = (max - min) / levels;
+	/* integers that fit on the levels are not quantized at all */
+	if ((a->dtype == ETCH_UINT32 || a->dtype == ETCH_INT32) &&
+			max - min <= levels)
+		t->scale = 1;
+	if (t->scale == 0)
+		t->scale = 1;
+	t->nblocks = (t->count + ETCH_TRACK_BLOCK - 1) / ETCH_TRACK_BLOCK;
+	t->blocks = malloc(sizeof(Etch_Track_Block) * t->nblocks);
+	/* the worst case of every keyframe */
+	t->data = malloc(t->count * (1 + 10 + t->bytes + sizeof(Etch_Interpolator_Type_Data)));
+
+	p = t->data;
+	EINA_INLIST_FOREACH(a->keys, k)
+	{
+		unsigned int size;
+		unsigned int q;
+		unsigned char header;
+
+		if (!(i % ETCH_TRACK_BLOCK))
+		{
+			t->blocks[i / ETCH_TRACK_BLOCK].time = k->time;
+			t->blocks[i / ETCH_TRACK_BLOCK].offset = p - t->data;
+			prev = k->time;
+			delta = 0;
+		}
+		size = _payload_size(k->type);
+		header = k->type;
+		if (size && !_payload_empty(k, size))
+			header |= ETCH_TRACK_PAYLOAD;
+		*p++ = header;
+		p = _varint_write(p, _zigzag_encode((int64_t)((k->time - prev) / unit) - delta));
+		delta = (k->time - prev) / unit;
+		prev = k->time;
+		_value_get(a->dtype, &k->value, &v);
+		q = lround((v - min) / t->scale);
+		*p++ = q & 0xff;
+		if (t->bytes == 2)
+			*p++ = q >> 8;
+		if (header & ETCH_TRACK_PAYLOAD)
+		{
+			memcpy(p, &k->idata, size);
+			p += size;
+		}
+		i++;
+	}
+	t->size = p - t->data;
+	t->data = realloc(t->data, t->size);
+	t->keys[0].animation = a;
+	t->keys[1].animation = a;
+
+	return t;
+}
+
+void etch_track_free(Etch_Track *t)
+{
+	free(t->data);
+	free(t->blocks);
+	free(t);
+}
+
+unsigned int etch_track_size_get(Etch_Track *t)
+{
+	return sizeof(Etch_Track) + t->size +
+			t->nblocks * sizeof(Etch_Track_Block);
+}
+
+/* Decode the segment where a time is into two keyframes, the ones of the
+ * caller when keys is not NULL, so other threads can decode without touching
+ * the keyframes of the track. The keyframes of the track are only valid
+ * until the next call */
+Eina_Bool etch_track_segment_get(Etch_Track *t, Etch_Data_Type dtype,
+		Etch_Time curr, Etch_Animation_Keyframe *keys,
+		Etch_Animation_Keyframe **start, Etch_Animation_Keyframe **end)
+{
+	const unsigned char *p;
+	Etch_Animation_Keyframe *s;
+	Etch_Animation_Keyframe *e;
+	unsigned int lo = 0, hi = t->nblocks;
+	unsigned int i;
+	int64_t delta = 0;
+
+	if (t->count < 2 || curr < t->blocks[0].time)
+		return EINA_FALSE;
+	if (!keys)
+		keys = t->keys;
+	s = &keys[0];
+	e = &keys[1];
+	/* the last block that starts before the time */
+	while (hi - lo > 1)
+	{
+		unsigned int mid = (lo + hi) / 2;
+
+		if (t->blocks[mid].time <= curr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	i = lo * ETCH_TRACK_BLOCK;
+	p = t->data + t->blocks[lo].offset;
+	p = _decode(t, dtype, p, t->blocks[lo].time, &delta, s);
+	/* the keyframe where the block starts can be the end of the
+	 * segment that starts on the previous block */
+	if (s->time == curr && lo)
+	{
+		p = t->data + t->blocks[lo - 1].offset;
+		i = (lo - 1) * ETCH_TRACK_BLOCK;
+		p = _decode(t, dtype, p, t->blocks[lo - 1].time, &delta, s);
+	}
+	for (i++; i < t->count; i++)
+	{
+		Etch_Animation_Keyframe *tmp;
+		Etch_Time base = s->time;
+
+		if (!(i % ETCH_TRACK_BLOCK))
+		{
+			base = t->blocks[i / ETCH_TRACK_BLOCK].time;
+			delta = 0;
+		}
+		p = _decode(t, dtype, p, base, &delta, e);
+		if (s->time <= curr && curr <= e->time)
+		{
+			*start = s;
+			*end = e;
+			return EINA_TRUE;
+		}
+		tmp = s;
+		s = e;
+		e = tmp;
+	}
+	return EINA_FALSE;
+}
+/*============================================================================*
+ *                                   API                                      *
+ *============================================================================*/
+/**
+ * Convert the keyframes of an animation into a compact track. The keyframe
+ * times are kept exactly and the values are quantized to the given number
+ * of bits against the range of values of the animation. Once compacted the
+ * keyframes are freed and no keyframe can be added, removed or modified.
+ * The keyframes given to the animation callbacks are decoded copies owned
+ * by the track. Only the animations of numeric data types can be compacted
+ * @param a The Etch_Animation
+ * @param bits The bits of every value, 8 or 16
+ * @return EINA_TRUE if the animation has been compacted, EINA_FALSE otherwise
+ */
+EAPI Eina_Bool etch_animation_compact(Etch_Animation *a, unsigned int bits)
+{
+	Etch_Animation_Keyframe *k;
+	Eina_Inlist *l2;
+	Etch_Track *t;
+
+	assert(a);
+	if (a->etch->record)
+		etch_record_animation(a, ETCH_RECORD_ANIMATION_COMPACT, bits);
+	if (bits != 8 && bits != 16)
+		return EINA_FALSE;
+	if (a->track)
+		return EINA_FALSE;
+	if (a->unsorted)
+		etch_animation_keyframes_sort(a);
+	t = etch_track_new(a, bits);
+	if (!t)
+		return EINA_FALSE;
+
+	EINA_INLIST_FOREACH_SAFE(a->keys, l2, k)
+	{
+		a->keys = eina_inlist_remove(a->keys, EINA_INLIST_GET(k));
+		etch_animation_keyframe_free(k);
+	}
+	a->unordered = eina_list_free(a->unordered);
+	a->track = t;
+	/* the values are quantized now */
+	if (a->seg_start)
+	{
+		a->seg_start = a->seg_end = NULL;
+		etch_animation_dirty(a);
+	}
+
+	return EINA_TRUE;
+}
+/**
+ * Get the memory used by the keyframes of an animation
+ * @param a The Etch_Animation
+ * @return The size in bytes
+ */
+EAPI unsigned int etch_animation_keyframes_size_get(Etch_Animation *a)
+{
+	assert(a);
+	if (a->track)
+		return etch_track_size_get(a->track);
+	return a->count * sizeof(Etch_Animation_Keyframe);
+}